@@ -3,9 +3,14 @@
 
 #include <libtx/queue.h>
 
+/*
+ * iob_use count the references, the last tx_membuf_drop call
+ * iob_release to give the memory back to its owner.
+ */
 struct tx_membuf {
 	int iob_use;
 	void *iob_alloc;
+	void (*iob_release)(tx_membuf *mbp);
 };
 
 struct tx_aiobuf {
@@ -14,5 +19,45 @@ struct tx_aiobuf {
 	tx_membuf *iob_base;
 };
 
-#endif
+void tx_membuf_hold(tx_membuf *mbp);
+void tx_membuf_drop(tx_membuf *mbp);
+
+void tx_aiobuf_hold(tx_aiobuf *iobp);
+void tx_aiobuf_drop(tx_aiobuf *iobp);
+
+struct tx_loop_t;
+struct tx_mempool;
+
+/*
+ * per-loop slab pool of tx_membuf in size classes (256 byte to 64K, larger
+ * request fall back to malloc). iob_alloc point to the data, the buffer
+ * come with one reference and go back to the pool on the last drop.
+ * freed buffers first go to a small thread-local cache per class, shared
+ * by the loops of the thread, and overflow to the free list of their pool.
+ * a tx_membuf must be dropped on the thread running its loop, and not
+ * outlive the loop. the counters are kept by the pool owning the buffer,
+ * even when the cache hand it to an other loop of the thread.
+ */
+#define MEMPOOL_CLASSES 5
+
+struct tx_mempool_stat {
+	unsigned mp_allocs;
+	unsigned mp_cachehits;
+	unsigned mp_slabs;
+	unsigned mp_inuse;
+	unsigned mp_large;
+};
 
+tx_membuf *tx_membuf_alloc(tx_loop_t *loop, size_t size);
+
+/* capacity of a pool buffer, 0 for a tx_membuf from elsewhere */
+size_t tx_membuf_size(tx_membuf *mbp);
+
+/* iobp reference len byte at off in mbp, and hold one reference of it */
+void tx_aiobuf_slice(tx_aiobuf *iobp, tx_membuf *mbp, size_t off, size_t len);
+int  tx_aiobuf_alloc(tx_aiobuf *iobp, tx_loop_t *loop, size_t len);
+
+const tx_mempool_stat *tx_mempool_getstat(tx_loop_t *loop);
+void tx_mempool_free(tx_loop_t *loop);
+
+#endif
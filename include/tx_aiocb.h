@@ -2,6 +2,8 @@
 #define _TX_AIOCB_
 
 struct tx_aiocb;
+struct tx_outq;
+struct tx_zcopy;
 struct tx_loop_t;
 
 #define TX_LISTEN   0x01
@@ -12,10 +14,21 @@ struct tx_loop_t;
 #define TX_ATTACHED 0x20
 #define TX_DETACHED 0x40
 #define TX_MEMLOCK  0x80
+#define TX_INTIMEOUT  0x100
+#define TX_OUTTIMEOUT 0x200
+#define TX_SHARED   0x400
+#define TX_ZEROCOPY 0x800
+#define TX_AUTOCORK 0x1000
+#define TX_UDPGSO   0x2000
+
+/* flag bits from TX_POLLER_PRIVATE up are owned by the poller backend */
+#define TX_POLLER_PRIVATE 0x10000
 
 #define tx_readable(filp) ((filp)->tx_flags & TX_READABLE)
 #define tx_writable(filp) ((filp)->tx_flags & TX_WRITABLE)
 #define tx_acceptable(filp) ((filp)->tx_flags & TX_READABLE)
+#define tx_aincb_timeout(filp) ((filp)->tx_flags & TX_INTIMEOUT)
+#define tx_outcb_timeout(filp) ((filp)->tx_flags & TX_OUTTIMEOUT)
 
 struct tx_aiocb_op {
 	void (*op_active_out)(tx_aiocb *f, tx_task_t *t);
@@ -33,28 +46,129 @@ struct tx_aiocb {
 
 	tx_task_t *tx_filterin;
 	tx_task_t *tx_filterout;
+
+	tx_timer_t tx_deadin;
+	tx_timer_t tx_deadout;
+
+	tx_outq *tx_oqp;
+	tx_zcopy *tx_zcp;
 };
 
 void tx_listen_init(tx_aiocb *filp, tx_loop_t *loop, int fd);
+void tx_listen_init(tx_aiocb *filp, tx_poll_t *poll, int fd);
+
+/*
+ * listener whose fd is also attached by other loops: the epoll backend
+ * register it with EPOLLEXCLUSIVE so one connection wake only one loop.
+ */
+void tx_listen_shared(tx_aiocb *filp, tx_loop_t *loop, int fd);
 int  tx_listen_accept(tx_aiocb *filp, struct sockaddr *sa0, size_t *plen);
+
+/*
+ * accept up to count pending connections at once, already non-blocking
+ * and close-on-exec (accept4 where available). when newcbs is not NULL,
+ * newcbs[i] is also initialised on the listener poller for newfds[i].
+ * return the number accepted, or -1 with errno when there is none.
+ */
+int  tx_listen_acceptv(tx_aiocb *filp, int newfds[], tx_aiocb *newcbs[], int count);
 #define tx_listen_active(filp, task) tx_aincb_active(filp, task)
 #define tx_listen_fini(filp)  tx_aiocb_fini(filp)
 
 void tx_aiocb_init(tx_aiocb *filp, tx_loop_t *loop, int fd);
+void tx_aiocb_init(tx_aiocb *filp, tx_poll_t *poll, int fd);
 int  tx_aiocb_connect(tx_aiocb *filp, struct sockaddr *sa0, size_t len, tx_task_t *t);
 void tx_aiocb_fini(tx_aiocb *filp);
 
 void tx_aincb_active(tx_aiocb *filp, tx_task_t *task);
 void tx_aincb_update(tx_aiocb *filp, int transfer);
 void tx_aincb_stop(tx_aiocb *filp, void *verify);
+void tx_aincb_wakeup(tx_aiocb *filp);
 
 void tx_outcb_prepare(tx_aiocb *filp, tx_task_t *task, int flags);
 void tx_outcb_cancel(tx_aiocb *filp, void *verify);
+void tx_outcb_wakeup(tx_aiocb *filp);
+void tx_outcb_update(tx_aiocb *filp, int transfer);
+
+/*
+ * wait with a deadline in milliseconds: if the fd is not ready in time,
+ * the task is activated with the deadline timer as reason and
+ * tx_aincb_timeout/tx_outcb_timeout set, readiness cancel the deadline.
+ * the flag is cleared by the next tx_aincb_active/tx_outcb_prepare.
+ */
+void tx_aincb_deadline(tx_aiocb *filp, tx_task_t *task, unsigned umilsec);
+void tx_outcb_deadline(tx_aiocb *filp, tx_task_t *task, unsigned umilsec);
 
-int tx_outcb_xsend(tx_aiocb *filp, struct tx_aiobuf *buf, size_t count);
 int tx_outcb_write(tx_aiocb *filp, const void *data, size_t len);
-int tx_outcb_sent(tx_aiocb *filp, int index); // get transfer
-int tx_outcb_stat(tx_aiocb *filp, int index);  // get out stat
+
+/*
+ * write count buffers at once: writev, or a single vectored send when the
+ * poller queue its own sends (it then hold a reference of each iob_base,
+ * and copy the buffers that have none). the return is like tx_outcb_write,
+ * a short write is resumed by the caller from the byte count.
+ */
+int tx_outcb_writev(tx_aiocb *filp, struct tx_aiobuf *buf, size_t count);
+
+/*
+ * send count byte of fd from *offset without copy to user space (copied
+ * through a pool buffer where sendfile is not usable). *offset advance by
+ * what was sent, the return is like tx_outcb_write: the byte sent, 0 at
+ * end of file, -1 with tx_writable cleared on EAGAIN. a pipe (linux) is
+ * spliced from its current position, at most what it hold, and 0 when it
+ * is empty.
+ */
+int tx_outcb_sendfile(tx_aiocb *filp, int fd, off_t *offset, size_t count);
+
+/*
+ * zero copy send (linux SO_ZEROCOPY): tx_aiocb_zerocopy enable it, return
+ * -1 when the kernel or the poller can not. tx_outcb_zsend is then used like
+ * tx_outcb_write, but the pages are sent in place and every successful call
+ * hold a reference of buf->iob_base until the kernel report it done on the
+ * socket error queue. the poller reap these reports on EPOLLERR, and
+ * tx_aiocb_zreap can reap them at any time, it return the number of sends
+ * released, or -1 with the errno of a report of an other origin it had to
+ * take off the queue along with them. small sends are copied anyway.
+ * tx_outcb_zpending count the sends not yet released, wait for 0 before
+ * tx_aiocb_fini or the pages may be reused while still on the wire,
+ * tx_outcb_zdrained activate task when it reach 0 (now if it already is).
+ */
+int tx_aiocb_zerocopy(tx_aiocb *filp);
+int tx_aiocb_zreap(tx_aiocb *filp);
+int tx_outcb_zsend(tx_aiocb *filp, struct tx_aiobuf *buf);
+int tx_outcb_zpending(tx_aiocb *filp);
+void tx_outcb_zdrained(tx_aiocb *filp, tx_task_t *task);
+
+/*
+ * output queue: tx_outcb_xsend queue count segments (holding a reference
+ * of each iob_base, a NULL base must stay valid until sent) and flush them
+ * with writev now and whenever the fd become writable, partial writes
+ * resume where they stopped. segments are numbered in queue order, the
+ * return is the index of the last one queued, or -1 with errno after a
+ * write error, or EINVAL when count is 0. do not mix with tx_outcb_write
+ * while the queue is not empty.
+ * tx_outcb_sent: 1 once segment index is completely written, else 0.
+ * tx_outcb_stat: one of the TX_OUTQ_* counters below.
+ * tx_outcb_drained: activate task once the queue is empty (or failed).
+ */
+#define TX_OUTQ_DONE     0
+#define TX_OUTQ_SEGMENTS 1
+#define TX_OUTQ_BYTES    2
+#define TX_OUTQ_SENT     3
+#define TX_OUTQ_ERROR    4
+
+int tx_outcb_xsend(tx_aiocb *filp, struct tx_aiobuf *buf, size_t count);
+int tx_outcb_sent(tx_aiocb *filp, int index);
+int tx_outcb_stat(tx_aiocb *filp, int index);
+void tx_outcb_drained(tx_aiocb *filp, tx_task_t *task);
+
+/*
+ * auto cork: tx_outcb_write copy into the output queue and the queue is
+ * flushed once at the end of the loop pass, so the small writes of one
+ * pass leave in a single writev. the write fail with EAGAIN only when
+ * a lot is queued and the fd is full, tx_outcb_prepare then wait for the
+ * queue to drain. sendfile and zsend flush the queue first. disabling
+ * flush what is queued. return -1 when the queue can not be allocated.
+ */
+int tx_aiocb_autocork(tx_aiocb *filp, int enable);
 
 #endif
 
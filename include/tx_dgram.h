@@ -0,0 +1,57 @@
+#ifndef _TX_DGRAM_
+#define _TX_DGRAM_
+
+struct tx_aiocb;
+
+/*
+ * one datagram: the payload in dg_buf, which hold a reference of a pool
+ * tx_membuf, and the peer address (source on receive, destination on send).
+ * dg_segsize not 0 mean dg_buf carry a train of packets of that size (the
+ * last one may be shorter): sent with UDP_SEGMENT, or coalesced by UDP_GRO.
+ */
+struct tx_dgram {
+	tx_aiobuf dg_buf;
+	size_t dg_segsize;
+	socklen_t dg_addrlen;
+	struct sockaddr_storage dg_addr;
+};
+
+/*
+ * receive up to count datagrams of at most size byte with as few syscalls
+ * as possible (recvmmsg on linux). dgs[i].dg_buf is reused when it already
+ * hold a large enough buffer nobody else reference, else a pool buffer is
+ * taken (start with zeroed dgs). return the number received, or -1 with
+ * errno, tx_readable is cleared when the socket is drained.
+ */
+int tx_dgram_recv(tx_aiocb *filp, tx_dgram dgs[], int count, size_t size);
+
+/*
+ * send count datagrams (sendmmsg on linux), return the number sent or -1.
+ * a train is sent with UDP_SEGMENT when tx_dgram_offload enabled GSO, else
+ * one packet at a time, a train sent in part has its dg_buf advanced past
+ * the packets gone. dg_segsize above 65535 fail with EINVAL.
+ */
+int tx_dgram_send(tx_aiocb *filp, tx_dgram dgs[], int count);
+
+/*
+ * enable segmentation offload on the socket: TX_DGRAM_GSO let the kernel
+ * split the trains (at most 64 segments and 64K per datagram), TX_DGRAM_GRO
+ * let the kernel coalesce received packets (receive with size 65535 then).
+ * return the subset of flags the kernel support.
+ */
+#define TX_DGRAM_GSO 0x01
+#define TX_DGRAM_GRO 0x02
+
+int tx_dgram_offload(tx_aiocb *filp, int flags);
+
+/*
+ * move up to count packets off the front of the train in dgp into segs,
+ * as slices of the same tx_membuf, no data is copied. return the number
+ * of packets moved, call again while dgp->dg_buf.iob_len is not 0.
+ */
+int tx_dgram_split(tx_dgram *dgp, tx_dgram segs[], int count);
+
+/* give the buffers of count datagrams back to the pool */
+void tx_dgram_drop(tx_dgram dgs[], int count);
+
+#endif
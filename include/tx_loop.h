@@ -55,7 +55,9 @@ struct tx_loop_t {
 	int tx_upcount;
 	void *tx_holder;
 	tx_poll_t *tx_poller;
+	struct tx_mempool *tx_mempool;
 	tx_task_q tx_taskq;
+	tx_task_q tx_deferq;
 	tx_task_t tx_tailer;
 	tx_task_t *tx_current;
 };
@@ -70,6 +72,12 @@ void tx_loop_break(tx_loop_t *up);
 void tx_loop_main(tx_loop_t *up);
 void tx_loop_stop(tx_loop_t *up);
 
+/*
+ * run task once at the end of the current pass, after every active task.
+ * a task deferred again from a deferred run wait for the next pass.
+ */
+void tx_loop_defer(tx_loop_t *up, tx_task_t *task);
+
 void tx_task_init(tx_task_t *task, tx_loop_t *loop, void (*call)(void *), void *ctx);
 void tx_task_active(tx_task_t *task, const void *reason);
 void tx_task_drop(tx_task_t *task);
@@ -9,8 +9,14 @@ struct tcpip_info {
 extern int ticks;
 unsigned int tx_getticks(void);
 extern volatile unsigned int tx_ticks;
+
+/* monotonic microseconds, for accounting only */
+unsigned long long tx_getusecs(void);
 int get_target_address(struct tcpip_info *info, const char *address);
 
+/* histogram slot of value: 0 for 0, k for [2^(k-1), 2^k), clamp to nslot - 1 */
+int tx_log2_slot(unsigned int value, int nslot);
+
 #ifndef offsetof
 #define offsetof(TYPE, MEMBER) ((size_t) &((TYPE *)0)->MEMBER)
 #endif
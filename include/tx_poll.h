@@ -2,11 +2,18 @@
 #define _TX_POLL_H_
 
 struct tx_aiocb;
+struct tx_aiobuf;
 struct tx_loop_t;
 struct tx_poll_t;
 
+/*
+ * tx_sendout/tx_sendoutv: backends that queue their own sends, the vectored
+ * one hold a reference of each iob_base for the time of the send.
+ * tx_connect: return 0, or -errno (-EINPROGRESS when the completion follow).
+ */
 struct tx_poll_op {
 	int (*tx_sendout)(tx_aiocb *filp, const void *buf, size_t len);
+	int (*tx_sendoutv)(tx_aiocb *filp, tx_aiobuf *bufs, size_t count);
 	int (*tx_connect)(tx_aiocb *filp, void *buf, size_t len);
 	int (*tx_accept)(tx_aiocb *filp, void *buf, size_t *len);
 	void (*tx_pollout)(tx_aiocb *filp);
@@ -15,9 +22,44 @@ struct tx_poll_op {
 	void (*tx_detach)(tx_aiocb *filp);
 };
 
+#define POLL_HIST_SLOTS 16
+
+/*
+ * ps_events: log2 histogram of events returned by one wait, see tx_log2_slot
+ * ps_accepts/ps_accept_misses: tx_listen_accept calls on this poller that
+ * got a connection or found none (EAGAIN), comparing them across the loops
+ * sharing a listener show how well the accepts are balanced.
+ * ps_waits/ps_empty_waits/ps_nevents: wait syscalls (epoll_wait, kevent,
+ * io_uring_enter, GetQueuedCompletionStatus), those returning nothing, and
+ * the events they returned in total.
+ * ps_ctl_add/ps_ctl_mod/ps_ctl_del: interest change syscalls by op.
+ * ps_failures: wait or interest change syscalls that returned an error.
+ * ps_stale_events: events dropped because the aiocb was detached meanwhile.
+ * ps_blocked_us: time spent inside the wait syscall.
+ * ps_dispatch_us: time from one wait returning to the next wait, that is
+ * the callbacks and the other tasks of the loop.
+ */
+struct tx_poll_stat {
+	unsigned ps_events[POLL_HIST_SLOTS];
+	unsigned ps_accepts;
+	unsigned ps_accept_misses;
+	unsigned ps_waits;
+	unsigned ps_empty_waits;
+	unsigned long long ps_nevents;
+	unsigned ps_ctl_add;
+	unsigned ps_ctl_mod;
+	unsigned ps_ctl_del;
+	unsigned ps_failures;
+	unsigned ps_stale_events;
+	unsigned long long ps_blocked_us;
+	unsigned long long ps_dispatch_us;
+};
+
 struct tx_poll_t {
 	tx_task_t tx_task;
 	tx_poll_op *tx_ops;
+	tx_poll_stat tx_stat;
+	unsigned long long tx_mark;
 };
 
 tx_poll_t *tx_poll_get(tx_loop_t *loop);
@@ -26,6 +68,13 @@ void tx_poll_init(tx_poll_t *t, tx_loop_t *l, void (*c)(void *), void *x);
 void tx_poll_active(tx_poll_t *poll);
 void tx_poll_drop(tx_poll_t *task);
 
+/* pollers call these around every wait syscall, nevent -1 on failure */
+void tx_poll_waitstart(tx_poll_t *poll);
+void tx_poll_waitdone(tx_poll_t *poll, int nevent);
+
+const tx_poll_stat *tx_poll_getstat(tx_poll_t *poll);
+void tx_poll_resetstat(tx_poll_t *poll);
+
 struct tx_inout_t {
 	int tx_len;
 	int tx_flags;
@@ -38,6 +87,40 @@ void tx_inout_drop(tx_inout_t *iocbp);
 tx_poll_t *tx_completion_port_init(tx_loop_t *loop);
 tx_poll_t *tx_kqueue_init(tx_loop_t *loop);
 tx_poll_t *tx_epoll_init(tx_loop_t *loop);
+tx_poll_t *tx_uring_init(tx_loop_t *loop);
+
+/*
+ * TX_URING_FIXEDFILE: register attached fds with the ring.
+ * TX_URING_FIXEDBUF: register a fixed buffer pool, used for queued sends
+ * and by tx_uring_recv instead of the provided buffer ring.
+ * TX_URING_SQPOLL: kernel side submission thread, idle after sqidle ms.
+ * a feature the kernel refuse is silently dropped.
+ */
+#define TX_URING_FIXEDFILE 0x01
+#define TX_URING_FIXEDBUF  0x02
+#define TX_URING_SQPOLL    0x04
+tx_poll_t *tx_uring_init(tx_loop_t *loop, int flags, unsigned sqidle);
+
+/*
+ * listeners attached to an io_uring poller accept with one multishot
+ * accept. tx_uring_recv switch the aiocb to multishot recv into the
+ * provided buffer ring of the poller (created on first use, or sized by
+ * tx_uring_bufring, count must be a power of two), every received buffer
+ * hold one tx_membuf reference, tx_aiobuf_drop give it back to the kernel.
+ * return the length, 0 at eof, -1 with errno EAGAIN when nothing queued.
+ */
+int tx_uring_bufring(tx_poll_t *poll, unsigned count, unsigned size);
+int tx_uring_recv(tx_aiocb *filp, tx_aiobuf *buf);
+int tx_epoll_maxevents(tx_poll_t *poll, int maxevents);
+
+/*
+ * TX_EPOLL_ONESHOT: rearm with EPOLL_CTL_MOD after every event (default).
+ * TX_EPOLL_EDGE: register once with EPOLLIN| EPOLLOUT| EPOLLET, interest is
+ * tracked in tx_flags only. the mode apply to fds attached after the call.
+ */
+#define TX_EPOLL_ONESHOT 0
+#define TX_EPOLL_EDGE    1
+int tx_epoll_mode(tx_poll_t *poll, int mode);
 
 #endif
 
@@ -0,0 +1,42 @@
+#ifndef _TX_RELAY_
+#define _TX_RELAY_
+
+struct tx_aiocb;
+struct tx_membuf;
+struct tx_task_t;
+
+/*
+ * move everything read from src to dst until eof, then shutdown the write
+ * side of dst (half close) and activate the done task. reads wait for the
+ * data already taken to be written, so a slow dst throttle src.
+ * on linux the data go through a per-relay pipe with splice and never
+ * reach user space, otherwise, or when splice is refused, it is copied
+ * through a pool buffer. rl_error is the errno that stopped the relay,
+ * 0 at eof.
+ */
+#define TX_RELAY_SPLICE 0x01
+#define TX_RELAY_EOF    0x02
+#define TX_RELAY_DONE   0x04
+
+struct tx_relay {
+	int rl_flags;
+	int rl_error;
+	int rl_pipe[2];
+	size_t rl_inpipe;
+	size_t rl_total;
+
+	tx_aiocb *rl_src;
+	tx_aiocb *rl_dst;
+
+	tx_membuf *rl_buf;
+	size_t rl_off, rl_len;
+
+	tx_task_t rl_task;
+	tx_task_t *rl_done;
+};
+
+void tx_relay_init(tx_relay *relay, tx_aiocb *src, tx_aiocb *dst);
+void tx_relay_start(tx_relay *relay, tx_task_t *done);
+void tx_relay_fini(tx_relay *relay);
+
+#endif
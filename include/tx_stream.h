@@ -0,0 +1,71 @@
+#ifndef _TX_STREAM_
+#define _TX_STREAM_
+
+struct tx_aiocb;
+struct tx_task_t;
+
+/*
+ * buffered stream over a tx_aiocb. input is read into a ring buffer that
+ * double when full, up to st_inlimit, output is queued and flushed when
+ * the fd become writable. the read and write calls complete right away
+ * when they can, otherwise they return 0 and activate the task once they
+ * can complete, the task then repeat the same call to get the result.
+ */
+#define TX_STREAM_EOF   0x01
+#define TX_STREAM_ERROR 0x02
+
+struct tx_stream {
+	int st_flags;
+	int st_error;
+	tx_aiocb *st_file;
+
+	char *st_inbuf;
+	size_t st_insize;
+	size_t st_inlimit;
+	size_t st_inhead;
+	size_t st_intail;
+	size_t st_scanned;
+
+	int st_delim;
+	size_t st_want;
+	tx_task_t *st_reader;
+	tx_task_t st_inpump;
+
+	char *st_outbuf;
+	size_t st_outsize;
+	size_t st_outhead;
+	size_t st_outtail;
+	tx_task_t *st_writer;
+	tx_task_t st_outpump;
+};
+
+/* insize and inlimit 0 select the defaults, the stream does not own filp */
+void tx_stream_init(tx_stream *stream, tx_aiocb *filp, size_t insize, size_t inlimit);
+void tx_stream_fini(tx_stream *stream);
+
+/*
+ * tx_stream_readuntil: length of the buffered data up to and including
+ * delim. tx_stream_readexact: len, once len byte are buffered.
+ * both return 0 when pending, -1 at eof or error (what was read stay
+ * buffered), or with errno ENOBUFS when the line grow over st_inlimit.
+ * the data is then at tx_stream_peek and released by tx_stream_consume.
+ */
+int tx_stream_readuntil(tx_stream *stream, int delim, tx_task_t *task);
+int tx_stream_readexact(tx_stream *stream, size_t len, tx_task_t *task);
+
+size_t tx_stream_buffered(tx_stream *stream);
+char  *tx_stream_peek(tx_stream *stream, size_t len);
+void   tx_stream_consume(tx_stream *stream, size_t len);
+
+/*
+ * queue all of data: return len when everything queued is already
+ * written, 0 when the task will be activated once it is, -1 on error.
+ * task may be NULL, the queue is still flushed in background.
+ */
+int tx_stream_writeall(tx_stream *stream, const void *data, size_t len, tx_task_t *task);
+
+/* wait for the queue to drain: 1 already drained, 0 pending, -1 on error */
+int tx_stream_flush(tx_stream *stream, tx_task_t *task);
+size_t tx_stream_pending(tx_stream *stream);
+
+#endif
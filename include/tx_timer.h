@@ -6,18 +6,45 @@ struct tx_timer_ring;
 
 void tx_timer_init(tx_timer_t *timer, tx_timer_ring *ring, tx_task_t *task);
 void tx_timer_init(tx_timer_t *timer, tx_loop_t *loop, tx_task_t *task);
+void tx_timer_init(tx_timer_t *timer, tx_timer_ring *ring, void (*call)(void *), void *data);
+void tx_timer_init(tx_timer_t *timer, tx_loop_t *loop, void (*call)(void *), void *data);
 void tx_timer_reset(tx_timer_t *timer, unsigned umilsec);
+void tx_timer_period(tx_timer_t *timer, unsigned umilsec, int policy);
 void tx_timer_drain(tx_timer_t *timer);
 void tx_timer_stop(tx_timer_t *timer);
 
 struct tx_loop_t;
 #define TIMER_IDLE 0x01
+#define TIMER_PERIODIC 0x02
+#define TIMER_CATCHUP  0x04
+#define TIMER_CALLOUT  0x08
 #define tx_timer_idle(t) ((t)->tx_flags & TIMER_IDLE)
 
+/*
+ * missed tick policy for periodic timer, the schedule is always anchored
+ * to the first deadline, so callback jitter never accumulate.
+ * TIMER_SKIP: drop the missed ticks, fire at the next slot on the grid.
+ * TIMER_CATCHUP: fire once for every missed tick, one per wheel slot.
+ * tx_overrun count the missed ticks in both case.
+ */
+#define TIMER_SKIP 0x00
+
+/*
+ * TIMER_CALLOUT timer carry the callback itself, no tx_task_t is needed.
+ * expired callout are batched and called directly from tx_timer_polling,
+ * without a hop through the loop task queue.
+ */
+
 struct tx_timer_t {
 	int tx_flags;
 	unsigned interval;
-	tx_task_t *tx_task;
+	unsigned tx_period;
+	unsigned tx_overrun;
+	union {
+		tx_task_t *tx_task;
+		void (*tx_call)(void *ctx);
+	};
+	void *tx_data;
 	tx_timer_ring *tx_ring;
 	LIST_ENTRY(tx_timer_t) entries;
 };
@@ -25,5 +52,32 @@ struct tx_timer_t {
 typedef LIST_HEAD(tx_timer_q, tx_timer_t) tx_timer_q;
 struct tx_timer_ring* tx_timer_ring_get(tx_loop_t *loop);
 
+#define TIMER_LEVEL_MI   0
+#define TIMER_LEVEL_MA   1
+#define TIMER_LEVEL_ST   2
+#define TIMER_LEVEL_FIRE 3
+#define TIMER_LEVELS     4
+#define TIMER_HIST_SLOTS 16
+
+/*
+ * histogram slot k count value in [2^(k-1), 2^k), see tx_log2_slot.
+ * ts_late is the fire lateness in milliseconds (actual tick - interval),
+ * ts_steps is the wheel steps walked by one tx_timer_polling call, more
+ * than one step mean the loop stalled and the wheel had to catch up.
+ */
+struct tx_timer_stat {
+	unsigned ts_timers[TIMER_LEVELS];
+	unsigned long ts_resets;
+	unsigned ts_reset_rate;
+	unsigned long ts_expires;
+	unsigned ts_late_max;
+	unsigned ts_late[TIMER_HIST_SLOTS];
+	unsigned long ts_catchups;
+	unsigned ts_steps_max;
+	unsigned ts_steps[TIMER_HIST_SLOTS];
+};
+
+const tx_timer_stat *tx_timer_ring_stat(tx_timer_ring *ring);
+
 #endif
 
@@ -4,12 +4,15 @@
 #include <tx_loop.h>
 #include <tx_poll.h>
 
-#include <tx_aiocb.h>
 #include <tx_timer.h>
+#include <tx_aiocb.h>
 #include <tx_platform.h>
 
 #include <tx_debug.h>
 #include <tx_aiobuf.h>
+#include <tx_stream.h>
+#include <tx_relay.h>
+#include <tx_dgram.h>
 #include <libtx/queue.h>
 
 struct module_stub {
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "txall.h"
+
+void tx_membuf_hold(tx_membuf *mbp)
+{
+	TX_ASSERT(mbp->iob_use > 0);
+	mbp->iob_use++;
+	return;
+}
+
+void tx_membuf_drop(tx_membuf *mbp)
+{
+	TX_ASSERT(mbp->iob_use > 0);
+	if (--mbp->iob_use == 0 &&
+			mbp->iob_release != NULL)
+		mbp->iob_release(mbp);
+	return;
+}
+
+void tx_aiobuf_hold(tx_aiobuf *iobp)
+{
+	if (iobp->iob_base != NULL)
+		tx_membuf_hold(iobp->iob_base);
+	return;
+}
+
+void tx_aiobuf_drop(tx_aiobuf *iobp)
+{
+	tx_membuf *mbp = iobp->iob_base;
+
+	iobp->iob_base = NULL;
+	if (mbp != NULL)
+		tx_membuf_drop(mbp);
+
+	return;
+}
+
+#define MEMPOOL_MINSHIFT  8
+#define MEMPOOL_SLABBYTES (256 * 1024)
+#define MEMPOOL_SLABMIN   4
+#define MEMPOOL_TLSCACHE  32
+#define MEMPOOL_HEADSIZE  64
+
+#if defined(WIN32)
+#define TX_THREAD __declspec(thread)
+#else
+#define TX_THREAD __thread
+#endif
+
+/*
+ * every slot start with this header, the data follow at MEMPOOL_HEADSIZE.
+ * ms_class is -1 for the large buffers, which are malloc'ed one by one.
+ */
+struct tx_memslot {
+	tx_membuf ms_mem;
+	tx_mempool *ms_pool;
+	tx_memslot *ms_next;
+	size_t ms_size;
+	int ms_class;
+};
+
+struct tx_memslab {
+	tx_memslab *ms_next;
+};
+
+struct tx_mempool {
+	tx_loop_t *mp_loop;
+	tx_memslab *mp_slabs;
+	tx_memslot *mp_free[MEMPOOL_CLASSES];
+	tx_mempool_stat mp_stat;
+};
+
+struct tx_memcache {
+	int mc_count[MEMPOOL_CLASSES];
+	tx_memslot *mc_slots[MEMPOOL_CLASSES][MEMPOOL_TLSCACHE];
+};
+
+static TX_THREAD tx_memcache _tls_memcache;
+
+static void tx_mempool_release(tx_membuf *mbp);
+
+static tx_mempool *tx_mempool_get(tx_loop_t *loop)
+{
+	tx_mempool *pool = loop->tx_mempool;
+
+	if (pool == NULL) {
+		pool = (tx_mempool *)calloc(1, sizeof(*pool));
+		TX_CHECK(pool != NULL, "create mempool failure");
+		if (pool != NULL) {
+			pool->mp_loop = loop;
+			loop->tx_mempool = pool;
+		}
+	}
+
+	return pool;
+}
+
+static int tx_mempool_class(size_t size)
+{
+	int cls = 0;
+	size_t limit = (1 << MEMPOOL_MINSHIFT);
+
+	while (cls < MEMPOOL_CLASSES && limit < size) {
+		limit <<= 2;
+		cls++;
+	}
+
+	return cls < MEMPOOL_CLASSES? cls: -1;
+}
+
+static int tx_mempool_grow(tx_mempool *pool, int cls)
+{
+	int i, count;
+	char *base;
+	size_t size, stride;
+	tx_memslab *slab;
+	tx_memslot *slot;
+
+	size = ((size_t)1 << (MEMPOOL_MINSHIFT + 2 * cls));
+	stride = MEMPOOL_HEADSIZE + size;
+	count = max(MEMPOOL_SLABBYTES / stride, MEMPOOL_SLABMIN);
+
+	slab = (tx_memslab *)malloc(MEMPOOL_HEADSIZE + count * stride);
+	TX_CHECK(slab != NULL, "grow mempool failure");
+	if (slab == NULL) {
+		return -1;
+	}
+
+	slab->ms_next = pool->mp_slabs;
+	pool->mp_slabs = slab;
+	pool->mp_stat.mp_slabs++;
+
+	base = (char *)slab + MEMPOOL_HEADSIZE;
+	for (i = count - 1; i >= 0; i--) {
+		slot = (tx_memslot *)(base + i * stride);
+		slot->ms_mem.iob_use = 0;
+		slot->ms_mem.iob_alloc = (char *)slot + MEMPOOL_HEADSIZE;
+		slot->ms_mem.iob_release = tx_mempool_release;
+		slot->ms_pool = pool;
+		slot->ms_size = size;
+		slot->ms_class = cls;
+		slot->ms_next = pool->mp_free[cls];
+		pool->mp_free[cls] = slot;
+	}
+
+	return 0;
+}
+
+tx_membuf *tx_membuf_alloc(tx_loop_t *loop, size_t size)
+{
+	int cls;
+	tx_memslot *slot;
+	tx_memcache *cache = &_tls_memcache;
+	tx_mempool *pool = tx_mempool_get(loop);
+
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	cls = tx_mempool_class(size);
+	if (cls == -1) {
+		slot = (tx_memslot *)malloc(MEMPOOL_HEADSIZE + size);
+		TX_CHECK(slot != NULL, "alloc large membuf failure");
+		if (slot == NULL) {
+			return NULL;
+		}
+
+		slot->ms_mem.iob_alloc = (char *)slot + MEMPOOL_HEADSIZE;
+		slot->ms_mem.iob_release = tx_mempool_release;
+		slot->ms_pool = pool;
+		slot->ms_size = size;
+		slot->ms_class = -1;
+		pool->mp_stat.mp_large++;
+	} else if (cache->mc_count[cls] > 0) {
+		/* the slot may come from an other loop pool of this thread, it stay its owner */
+		slot = cache->mc_slots[cls][--cache->mc_count[cls]];
+		pool = slot->ms_pool;
+		pool->mp_stat.mp_cachehits++;
+	} else {
+		if (pool->mp_free[cls] == NULL &&
+				tx_mempool_grow(pool, cls) != 0) {
+			return NULL;
+		}
+
+		slot = pool->mp_free[cls];
+		pool->mp_free[cls] = slot->ms_next;
+	}
+
+	pool->mp_stat.mp_allocs++;
+	pool->mp_stat.mp_inuse++;
+	slot->ms_mem.iob_use = 1;
+	return &slot->ms_mem;
+}
+
+static void tx_mempool_release(tx_membuf *mbp)
+{
+	tx_memslot *slot = container_of(mbp, tx_memslot, ms_mem);
+	tx_mempool *pool = slot->ms_pool;
+	tx_memcache *cache = &_tls_memcache;
+	int cls = slot->ms_class;
+
+	pool->mp_stat.mp_inuse--;
+	if (cls == -1) {
+		free(slot);
+		return;
+	}
+
+	if (cache->mc_count[cls] < MEMPOOL_TLSCACHE) {
+		cache->mc_slots[cls][cache->mc_count[cls]++] = slot;
+		return;
+	}
+
+	slot->ms_next = pool->mp_free[cls];
+	pool->mp_free[cls] = slot;
+	return;
+}
+
+size_t tx_membuf_size(tx_membuf *mbp)
+{
+	tx_memslot *slot = container_of(mbp, tx_memslot, ms_mem);
+	return mbp->iob_release == tx_mempool_release? slot->ms_size: 0;
+}
+
+void tx_aiobuf_slice(tx_aiobuf *iobp, tx_membuf *mbp, size_t off, size_t len)
+{
+	tx_membuf_hold(mbp);
+	iobp->iob_buf = (char *)mbp->iob_alloc + off;
+	iobp->iob_len = len;
+	iobp->iob_base = mbp;
+	return;
+}
+
+int tx_aiobuf_alloc(tx_aiobuf *iobp, tx_loop_t *loop, size_t len)
+{
+	tx_membuf *mbp;
+
+	mbp = tx_membuf_alloc(loop, len);
+	if (mbp == NULL) {
+		return -1;
+	}
+
+	/* the slice take over the allocation reference */
+	iobp->iob_buf = (char *)mbp->iob_alloc;
+	iobp->iob_len = len;
+	iobp->iob_base = mbp;
+	return 0;
+}
+
+const tx_mempool_stat *tx_mempool_getstat(tx_loop_t *loop)
+{
+	tx_mempool *pool = tx_mempool_get(loop);
+	return pool != NULL? &pool->mp_stat: NULL;
+}
+
+void tx_mempool_free(tx_loop_t *loop)
+{
+	int i, cls;
+	tx_memslab *slab;
+	tx_memcache *cache = &_tls_memcache;
+	tx_mempool *pool = loop->tx_mempool;
+
+	if (pool == NULL) {
+		return;
+	}
+
+	TX_CHECK(pool->mp_stat.mp_inuse == 0, "mempool freed with buffers in use");
+	if (pool->mp_stat.mp_inuse != 0) {
+		/* leak the slabs rather than free memory still referenced */
+		return;
+	}
+
+	for (cls = 0; cls < MEMPOOL_CLASSES; cls++) {
+		for (i = 0; i < cache->mc_count[cls]; ) {
+			if (cache->mc_slots[cls][i]->ms_pool == pool) {
+				cache->mc_slots[cls][i] = cache->mc_slots[cls][--cache->mc_count[cls]];
+				continue;
+			}
+			i++;
+		}
+	}
+
+	while (pool->mp_slabs != NULL) {
+		slab = pool->mp_slabs;
+		pool->mp_slabs = slab->ms_next;
+		free(slab);
+	}
+
+	loop->tx_mempool = NULL;
+	free(pool);
+	return;
+}
@@ -1,29 +1,182 @@
 #include <stdio.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <unistd.h>
 #include <libtx/queue.h>
 
 #if defined(WIN32)
 #include <winsock2.h>
 #else
-#include <limits.h>
 #include <sys/uio.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #endif
 
+#if defined(__linux__)
+#include <string.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#endif
+
 #include "txall.h"
 
+#define SENDFILE_CHUNK (64 * 1024)
+#define ZEROCOPY_MIN   (16 * 1024)
+#define ZEROCOPY_SLOTS 64
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+#define OUTQ_IOV      64
+#define OUTQ_SEGMENTS 16
+
+#define CORK_BUFSIZE  (16 * 1024)
+#define CORK_LIMIT    (256 * 1024)
+
+/*
+ * oq_head/oq_tail are free running segment indices, the ring size is a
+ * power of two, oq_off is what was written of the head segment.
+ */
+struct tx_outq {
+	unsigned oq_head;
+	unsigned oq_tail;
+	unsigned oq_size;
+	size_t oq_off;
+	size_t oq_bytes;
+	unsigned long long oq_sent;
+	int oq_error;
+	tx_aiobuf *oq_segs;
+	tx_task_t oq_task;
+	tx_task_t oq_cork;
+	tx_task_t *oq_drained;
+	unsigned oq_corkseg;
+};
+
+/*
+ * every MSG_ZEROCOPY send that succeed get the next notification id from
+ * the kernel, zc_bufs keep the membuf of ids [zc_done, zc_next) in order,
+ * and a completion [lo, hi] release them up to hi. zc_task wait for
+ * zc_done to reach zc_next.
+ */
+struct tx_zcopy {
+	unsigned zc_next;
+	unsigned zc_done;
+	unsigned zc_size;
+	unsigned zc_copied;
+	tx_membuf **zc_bufs;
+	tx_task_t *zc_task;
+};
+
 void tx_outcb_prepare(tx_aiocb *filp, tx_task_t *task, int flags)
 {
+	tx_outq *oqp = filp->tx_oqp;
+
+	if (oqp != NULL && task == &oqp->oq_task) {
+		/* the queue own wait, a deadline of its drain waiter keep running */
+		return filp->tx_fops->op_active_out(filp, task);
+	}
+
+	/* a new wait, the previous deadline is forgotten */
+	filp->tx_flags &= ~TX_OUTTIMEOUT;
+	tx_timer_stop(&filp->tx_deadout);
+
+	if ((filp->tx_flags & TX_AUTOCORK) && oqp->oq_head != oqp->oq_tail) {
+		/* corked output still queued, the task wait for it to drain */
+		TX_CHECK(oqp->oq_drained == NULL || oqp->oq_drained == task, "output queue drain already waited");
+		oqp->oq_drained = task;
+		task = &oqp->oq_task;
+	}
+
 	return filp->tx_fops->op_active_out(filp, task);
 }
 
 void tx_outcb_cancel(tx_aiocb *filp, void *task)
 {
+	tx_outq *oqp = filp->tx_oqp;
+
+	if (oqp != NULL && oqp->oq_drained == task) {
+		oqp->oq_drained = NULL;
+		tx_timer_stop(&filp->tx_deadout);
+		return;
+	}
+
+	tx_timer_stop(&filp->tx_deadout);
 	return filp->tx_fops->op_cancel_out(filp, task);
 }
 
+void tx_outcb_wakeup(tx_aiocb *filp)
+{
+	tx_outq *oqp = filp->tx_oqp;
+	tx_task_t *task = filp->tx_filterout;
+
+	filp->tx_filterout = NULL;
+	if (oqp == NULL || task != &oqp->oq_task || oqp->oq_drained == NULL)
+		tx_timer_stop(&filp->tx_deadout);
+	tx_task_active(task, filp);
+	return;
+}
+
+static void tx_outcb_expired(void *up)
+{
+	tx_task_t *task;
+	tx_aiocb *filp = (tx_aiocb *)up;
+	tx_outq *oqp = filp->tx_oqp;
+
+	task = filp->tx_filterout;
+	if (oqp != NULL && task == &oqp->oq_task) {
+		/* the drain waiter time out, the queue keep waiting for the fd */
+		task = oqp->oq_drained;
+		oqp->oq_drained = NULL;
+		filp->tx_flags |= (task != NULL? TX_OUTTIMEOUT: 0);
+		tx_task_active(task, &filp->tx_deadout);
+		return;
+	}
+
+	if (task != NULL) {
+		filp->tx_filterout = NULL;
+		filp->tx_flags |= TX_OUTTIMEOUT;
+		tx_task_active(task, &filp->tx_deadout);
+	}
+
+	return;
+}
+
+static void tx_deadline_arm(tx_aiocb *filp, tx_timer_t *timer, unsigned umilsec)
+{
+	if (timer->tx_ring == NULL) {
+		tx_loop_t *loop = tx_loop_get(&filp->tx_poll->tx_task);
+		timer->tx_ring = tx_timer_ring_get(loop);
+	}
+
+	tx_timer_reset(timer, umilsec);
+	return;
+}
+
+void tx_outcb_deadline(tx_aiocb *filp, tx_task_t *task, unsigned umilsec)
+{
+	tx_outq *oqp = filp->tx_oqp;
+	tx_outcb_prepare(filp, task, 0);
+
+	if (filp->tx_filterout == task ||
+			(oqp != NULL && oqp->oq_drained == task && filp->tx_filterout == &oqp->oq_task)) {
+		tx_deadline_arm(filp, &filp->tx_deadout, umilsec);
+	}
+
+	return;
+}
+
 void tx_outcb_update(tx_aiocb *filp, int len)
 {
 	if (len >= 0) {
@@ -44,17 +197,18 @@ void tx_outcb_update(tx_aiocb *filp, int len)
 	return;
 }
 
-int tx_outcb_write(tx_aiocb *filp, const void *buf, size_t len)
+static int tx_outq_cork(tx_aiocb *filp, const void *buf, size_t len);
+
+static int tx_outcb_rawwrite(tx_aiocb *filp, const void *buf, size_t len)
 {
 	int n;
 	tx_poll_op *ops;
 
 	ops = filp->tx_poll->tx_ops;
 	if (ops->tx_sendout == NULL) {
-		n = write(filp->tx_fd, buf, len);
+		n = write(filp->tx_fd, buf, min(len, INT_MAX));
 		tx_outcb_update(filp, n);
 	} else {
-		len = (len < 8192? len: 8192);
 		n = ops->tx_sendout(filp, buf, len);
 		/* XXX */
 	}
@@ -62,38 +216,781 @@ int tx_outcb_write(tx_aiocb *filp, const void *buf, size_t len)
 	return n;
 }
 
-int tx_outcb_xsend(tx_aiocb *filp, tx_aiobuf buf[], size_t count)
+static int tx_outcb_rawwritev(tx_aiocb *filp, tx_aiobuf buf[], size_t count)
 {
+	int n;
+	tx_poll_op *ops = filp->tx_poll->tx_ops;
+
+	if (ops->tx_sendoutv != NULL) {
+		return ops->tx_sendoutv(filp, buf, count);
+	}
+
+	if (ops->tx_sendout != NULL || count == 1) {
+		return tx_outcb_rawwrite(filp, buf[0].iob_buf, buf[0].iob_len);
+	}
+
 #ifndef WIN32
-	ssize_t n = 0;
-	struct iovec vec[IOV_MAX];
+	size_t i, total = 0;
+	struct iovec vec[OUTQ_IOV];
 
-	TX_ASSERT(count < IOV_MAX);
-	for (int i = 0; i < count; i++) {
-		vec[i].iov_len = buf[i].iob_len;
+	for (i = 0; i < count && i < OUTQ_IOV; i++) {
+		if (total + buf[i].iob_len > INT_MAX) break;
 		vec[i].iov_base = buf[i].iob_buf;
+		vec[i].iov_len = buf[i].iob_len;
+		total += buf[i].iob_len;
 	}
 
-	n = writev(filp->tx_fd, vec, count);
+	n = writev(filp->tx_fd, vec, i);
 	tx_outcb_update(filp, n);
+#else
+	n = tx_outcb_rawwrite(filp, buf[0].iob_buf, buf[0].iob_len);
+#endif
 
 	return n;
+}
+
+int tx_outcb_write(tx_aiocb *filp, const void *buf, size_t len)
+{
+	if (filp->tx_flags & TX_AUTOCORK) {
+		return tx_outq_cork(filp, buf, len);
+	}
+
+	return tx_outcb_rawwrite(filp, buf, len);
+}
+
+static int tx_outq_uncork(tx_aiocb *filp);
+
+int tx_outcb_writev(tx_aiocb *filp, tx_aiobuf buf[], size_t count)
+{
+	if (tx_outq_uncork(filp) != 0) {
+		return -1;
+	}
+
+	return tx_outcb_rawwritev(filp, buf, count);
+}
+
+/* write as much of the queue as the fd take, 1 drained, 0 full, -1 error */
+static int tx_outq_flush(tx_aiocb *filp, tx_outq *oqp)
+{
+	int n;
+	int nvec;
+	unsigned i;
+	tx_aiobuf *seg;
+	tx_aiobuf vec[OUTQ_IOV];
+
+	while (oqp->oq_head != oqp->oq_tail) {
+		if (!tx_writable(filp)) {
+			return 0;
+		}
+
+		nvec = 0;
+		for (i = oqp->oq_head; i != oqp->oq_tail && nvec < OUTQ_IOV; i++) {
+			vec[nvec++] = oqp->oq_segs[i & (oqp->oq_size - 1)];
+		}
+
+		vec[0].iob_buf += oqp->oq_off;
+		vec[0].iob_len -= oqp->oq_off;
+		n = tx_outcb_rawwritev(filp, vec, nvec);
+
+		if (n < 0 && (!tx_writable(filp) || errno == EINTR)) {
+			continue;
+		}
+
+		if (n < 0) {
+			oqp->oq_error = errno;
+			return -1;
+		}
+
+		oqp->oq_sent += n;
+		oqp->oq_bytes -= n;
+		while (oqp->oq_head != oqp->oq_tail) {
+			seg = &oqp->oq_segs[oqp->oq_head & (oqp->oq_size - 1)];
+			if (oqp->oq_off + n < seg->iob_len) {
+				oqp->oq_off += n;
+				break;
+			}
+
+			n -= (seg->iob_len - oqp->oq_off);
+			oqp->oq_off = 0;
+			oqp->oq_head++;
+			tx_aiobuf_drop(seg);
+		}
+	}
+
+	/* a poller that queue its own sends may still have the tail in flight */
+	return tx_writable(filp)? 1: 0;
+}
+
+static void tx_outq_pump(void *up)
+{
+	int error;
+	tx_task_t *task;
+	tx_aiocb *filp = (tx_aiocb *)up;
+	tx_outq *oqp = filp->tx_oqp;
+
+	error = tx_outq_flush(filp, oqp);
+	if (error == 0) {
+		tx_outcb_prepare(filp, &oqp->oq_task, 0);
+		return;
+	}
+
+	task = oqp->oq_drained;
+	oqp->oq_drained = NULL;
+	tx_timer_stop(&filp->tx_deadout);
+	tx_task_active(task, filp);
+	return;
+}
+
+static tx_outq *tx_outq_get(tx_aiocb *filp)
+{
+	tx_outq *oqp = filp->tx_oqp;
+
+	if (oqp == NULL) {
+		oqp = (tx_outq *)calloc(1, sizeof(*oqp));
+		TX_CHECK(oqp != NULL, "alloc output queue failure");
+		if (oqp == NULL) {
+			return NULL;
+		}
+
+		tx_task_init(&oqp->oq_task, tx_loop_get(&filp->tx_poll->tx_task), tx_outq_pump, filp);
+		tx_task_init(&oqp->oq_cork, tx_loop_get(&filp->tx_poll->tx_task), tx_outq_pump, filp);
+		filp->tx_oqp = oqp;
+	}
+
+	return oqp;
+}
+
+static void tx_outq_free(tx_aiocb *filp)
+{
+	tx_outq *oqp = filp->tx_oqp;
+
+	if (oqp != NULL) {
+		oqp->oq_drained = NULL;
+		tx_outcb_cancel(filp, &oqp->oq_task);
+		tx_task_drop(&oqp->oq_task);
+		tx_task_drop(&oqp->oq_cork);
+		while (oqp->oq_head != oqp->oq_tail)
+			tx_aiobuf_drop(&oqp->oq_segs[oqp->oq_head++ & (oqp->oq_size - 1)]);
+		free(oqp->oq_segs);
+		free(oqp);
+		filp->tx_oqp = NULL;
+		filp->tx_flags &= ~TX_AUTOCORK;
+	}
+
+	return;
+}
+
+/* make room for count more segments in the ring */
+static int tx_outq_reserve(tx_outq *oqp, size_t count)
+{
+	unsigned size;
+	tx_aiobuf *segs;
+
+	if (oqp->oq_tail - oqp->oq_head + count > oqp->oq_size) {
+		size = max(oqp->oq_size, OUTQ_SEGMENTS);
+		while (size < oqp->oq_tail - oqp->oq_head + count) size *= 2;
+
+		segs = (tx_aiobuf *)malloc(size * sizeof(*segs));
+		TX_CHECK(segs != NULL, "grow output queue failure");
+		if (segs == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+
+		for (unsigned j = oqp->oq_head; j != oqp->oq_tail; j++)
+			segs[j & (size - 1)] = oqp->oq_segs[j & (oqp->oq_size - 1)];
+
+		free(oqp->oq_segs);
+		oqp->oq_segs = segs;
+		oqp->oq_size = size;
+	}
+
+	return 0;
+}
+
+int tx_outcb_xsend(tx_aiocb *filp, tx_aiobuf buf[], size_t count)
+{
+	int error;
+	size_t i;
+	tx_outq *oqp;
+	tx_task_t *task;
+
+	if (count == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	oqp = tx_outq_get(filp);
+	if (oqp == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	if (oqp->oq_error != 0) {
+		errno = oqp->oq_error;
+		return -1;
+	}
+
+	if (tx_outq_reserve(oqp, count) != 0) {
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		tx_aiobuf_hold(&buf[i]);
+		oqp->oq_segs[oqp->oq_tail++ & (oqp->oq_size - 1)] = buf[i];
+		oqp->oq_bytes += buf[i].iob_len;
+	}
+
+	error = tx_outq_flush(filp, oqp);
+	if (error == -1) {
+		/* a drain waiter see the error now, not at the next writable */
+		if (oqp->oq_drained != NULL) {
+			task = oqp->oq_drained;
+			oqp->oq_drained = NULL;
+			tx_timer_stop(&filp->tx_deadout);
+			tx_task_active(task, filp);
+		}
+
+		errno = oqp->oq_error;
+		return -1;
+	}
+
+	if (error == 0) {
+		tx_outcb_prepare(filp, &oqp->oq_task, 0);
+	}
+
+	return (int)((oqp->oq_tail - 1) & INT_MAX);
+}
+
+/*
+ * copy into the last corked segment while it has room, oq_corkseg is the
+ * oq_tail value right after that segment was queued.
+ */
+static int tx_outq_cork(tx_aiocb *filp, const void *buf, size_t len)
+{
+	int error;
+	size_t room = 0;
+	tx_aiobuf *seg = NULL;
+	tx_outq *oqp = filp->tx_oqp;
+	tx_loop_t *loop = tx_loop_get(&filp->tx_poll->tx_task);
+
+	if (oqp->oq_error != 0) {
+		errno = oqp->oq_error;
+		return -1;
+	}
+
+	if (oqp->oq_bytes >= CORK_LIMIT && !tx_writable(filp)) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	len = min(len, INT_MAX);
+	if (oqp->oq_head != oqp->oq_tail && oqp->oq_corkseg == oqp->oq_tail) {
+		seg = &oqp->oq_segs[(oqp->oq_tail - 1) & (oqp->oq_size - 1)];
+		room = tx_membuf_size(seg->iob_base) -
+			(seg->iob_buf - (char *)seg->iob_base->iob_alloc) - seg->iob_len;
+	}
+
+	if (room < len) {
+		if (tx_outq_reserve(oqp, 1) != 0) {
+			return -1;
+		}
+
+		seg = &oqp->oq_segs[oqp->oq_tail & (oqp->oq_size - 1)];
+		if (tx_aiobuf_alloc(seg, loop, max(len, CORK_BUFSIZE)) != 0) {
+			errno = ENOMEM;
+			return -1;
+		}
+
+		seg->iob_len = 0;
+		oqp->oq_corkseg = ++oqp->oq_tail;
+	}
+
+	memcpy(seg->iob_buf + seg->iob_len, buf, len);
+	seg->iob_len += len;
+	oqp->oq_bytes += len;
+
+	if (oqp->oq_bytes < CORK_LIMIT) {
+		tx_loop_defer(loop, &oqp->oq_cork);
+		return (int)len;
+	}
+
+	error = tx_outq_flush(filp, oqp);
+	if (error == 0) {
+		tx_outcb_prepare(filp, &oqp->oq_task, 0);
+	}
+
+	return (int)len;
+}
+
+/* flush the corked output before a write that bypass the queue */
+static int tx_outq_uncork(tx_aiocb *filp)
+{
+	int error;
+	tx_outq *oqp = filp->tx_oqp;
+
+	if ((filp->tx_flags & TX_AUTOCORK) == 0 || oqp->oq_head == oqp->oq_tail) {
+		return 0;
+	}
+
+	error = tx_outq_flush(filp, oqp);
+	if (error == 0) {
+		tx_outcb_prepare(filp, &oqp->oq_task, 0);
+		errno = EAGAIN;
+	}
+
+	return error > 0? 0: -1;
+}
+
+int tx_aiocb_autocork(tx_aiocb *filp, int enable)
+{
+	tx_outq *oqp;
+
+	if (enable) {
+		if (tx_outq_get(filp) == NULL) {
+			return -1;
+		}
+
+		filp->tx_flags |= TX_AUTOCORK;
+		return 0;
+	}
+
+	if (filp->tx_flags & TX_AUTOCORK) {
+		oqp = filp->tx_oqp;
+		filp->tx_flags &= ~TX_AUTOCORK;
+		tx_task_drop(&oqp->oq_cork);
+		if (oqp->oq_head != oqp->oq_tail)
+			tx_outq_pump(filp);
+	}
+
+	return 0;
+}
+
+int tx_outcb_sent(tx_aiocb *filp, int index)
+{
+	unsigned ahead;
+	tx_outq *oqp = filp->tx_oqp;
+
+	if (oqp == NULL) {
+		return 0;
+	}
+
+	/* index is before oq_head, by less than half of the number space */
+	ahead = (oqp->oq_head - (unsigned)index) & INT_MAX;
+	return ahead != 0 && ahead <= (INT_MAX >> 1);
+}
+
+int tx_outcb_stat(tx_aiocb *filp, int index)
+{
+	tx_outq *oqp = filp->tx_oqp;
+
+	if (oqp == NULL) {
+		return 0;
+	}
+
+	switch (index) {
+		case TX_OUTQ_DONE:
+			return (int)(oqp->oq_head & INT_MAX);
+
+		case TX_OUTQ_SEGMENTS:
+			return (int)(oqp->oq_tail - oqp->oq_head);
+
+		case TX_OUTQ_BYTES:
+			return (int)min(oqp->oq_bytes, INT_MAX);
+
+		case TX_OUTQ_SENT:
+			return (int)min(oqp->oq_sent, INT_MAX);
+
+		case TX_OUTQ_ERROR:
+			return oqp->oq_error;
+	}
+
+	return -1;
+}
+
+void tx_outcb_drained(tx_aiocb *filp, tx_task_t *task)
+{
+	tx_outq *oqp = filp->tx_oqp;
+
+	if (oqp == NULL || oqp->oq_error != 0 ||
+			(oqp->oq_head == oqp->oq_tail && tx_writable(filp))) {
+		tx_task_active(task, filp);
+		return;
+	}
+
+	oqp->oq_drained = task;
+	if (oqp->oq_head == oqp->oq_tail) {
+		tx_outcb_prepare(filp, &oqp->oq_task, 0);
+	}
+
+	return;
+}
+
+#if defined(__linux__)
+/*
+ * a pipe can not be read at an offset, and what is read from it can not
+ * be read again after a short write: splice what it hold straight to the
+ * fd, the rest stay in the pipe. *offset only count the progress.
+ */
+static int tx_sendfile_splice(tx_aiocb *filp, int fd, off_t *offset, size_t count)
+{
+	int avail = 0;
+	ssize_t n = 0;
+	size_t total = 0;
+
+	if (ioctl(fd, FIONREAD, &avail) != 0) {
+		return -1;
+	}
+
+	count = min(count, (size_t)avail);
+	while (total < count) {
+		n = splice(fd, NULL, filp->tx_fd, NULL, count - total, SPLICE_F_NONBLOCK| SPLICE_F_MOVE);
+		if (n > 0) {
+			total += n;
+			continue;
+		}
+
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+
+		tx_outcb_update(filp, n);
+		break;
+	}
+
+	*offset += total;
+	return total > 0? (int)total: (int)n;
+}
+#endif
+
+static int tx_sendfile_copy(tx_aiocb *filp, int fd, off_t *offset, size_t count)
+{
+	int n = 0;
+	size_t total = 0;
+	tx_membuf *mbp;
+
+	if (!tx_writable(filp)) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	mbp = tx_membuf_alloc(tx_loop_get(&filp->tx_poll->tx_task), SENDFILE_CHUNK);
+	if (mbp == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	while (total < count && tx_writable(filp)) {
+#ifndef WIN32
+		n = pread(fd, mbp->iob_alloc, min(count - total, SENDFILE_CHUNK), *offset);
+#if defined(__linux__)
+		if (n == -1 && errno == ESPIPE && total == 0) {
+			tx_membuf_drop(mbp);
+			return tx_sendfile_splice(filp, fd, offset, count);
+		}
+#endif
 #else
-	TX_CHECK(1, "not supported");
+		n = -1;
+		errno = ENOSYS;
+#endif
+		if (n <= 0) {
+			break;
+		}
+
+		n = tx_outcb_rawwrite(filp, mbp->iob_alloc, n);
+		if (n <= 0) {
+			break;
+		}
+
+		*offset += n;
+		total += n;
+	}
+
+	tx_membuf_drop(mbp);
+	return total > 0? (int)total: n;
+}
+
+int tx_outcb_sendfile(tx_aiocb *filp, int fd, off_t *offset, size_t count)
+{
+#if defined(__linux__)
+	ssize_t n = 0;
+	size_t total = 0;
+#endif
+
+	if (tx_outq_uncork(filp) != 0) {
+		return -1;
+	}
+
+#if defined(__linux__)
+	if (filp->tx_poll->tx_ops->tx_sendout != NULL) {
+		/* the poller queue its own sends, keep them in order */
+		return tx_sendfile_copy(filp, fd, offset, count);
+	}
+
+	while (total < count) {
+		n = sendfile(filp->tx_fd, fd, offset, count - total);
+		if (n > 0) {
+			total += n;
+			continue;
+		}
+
+		if (n == -1 && errno == EINTR) {
+			continue;
+		}
+
+		if (n == -1 && total == 0 && errno == ESPIPE) {
+			/* a pipe, it has no offset to send from */
+			return tx_sendfile_splice(filp, fd, offset, count);
+		}
+
+		if (n == -1 && total == 0 &&
+				(errno == EINVAL || errno == ENOSYS)) {
+			/* file type sendfile can not map */
+			return tx_sendfile_copy(filp, fd, offset, count);
+		}
+
+		break;
+	}
+
+	tx_outcb_update(filp, n);
+	return total > 0? (int)total: (int)n;
+#else
+	return tx_sendfile_copy(filp, fd, offset, count);
+#endif
+}
+
+int tx_aiocb_zerocopy(tx_aiocb *filp)
+{
+#if defined(__linux__)
+	int one = 1;
+	tx_zcopy *zcp;
+
+	if (filp->tx_zcp != NULL) {
+		return 0;
+	}
+
+	if (filp->tx_poll->tx_ops->tx_sendout != NULL) {
+		/* the poller copy into its own send queue */
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	if (setsockopt(filp->tx_fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+		return -1;
+	}
+
+	zcp = (tx_zcopy *)calloc(1, sizeof(*zcp));
+	TX_CHECK(zcp != NULL, "alloc zero copy state failure");
+	if (zcp == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	filp->tx_zcp = zcp;
+	filp->tx_flags |= TX_ZEROCOPY;
+	return 0;
+#else
+	errno = EOPNOTSUPP;
 	return -1;
 #endif
 }
 
+int tx_outcb_zpending(tx_aiocb *filp)
+{
+	tx_zcopy *zcp = filp->tx_zcp;
+	return zcp != NULL? (int)(zcp->zc_next - zcp->zc_done): 0;
+}
+
+void tx_outcb_zdrained(tx_aiocb *filp, tx_task_t *task)
+{
+	tx_zcopy *zcp = filp->tx_zcp;
+
+	if (zcp != NULL && zcp->zc_done != zcp->zc_next) {
+		TX_CHECK(zcp->zc_task == NULL || zcp->zc_task == task, "zero copy drain already waited");
+		zcp->zc_task = task;
+		return;
+	}
+
+	tx_task_active(task, filp);
+	return;
+}
+
+int tx_aiocb_zreap(tx_aiocb *filp)
+{
+#if defined(__linux__)
+	int n;
+	int reaped = 0;
+	int foreign = 0;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct sock_extended_err *serr;
+	char control[128];
+	tx_zcopy *zcp = filp->tx_zcp;
+
+	if (zcp == NULL) {
+		return 0;
+	}
+
+	for ( ; ; ) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		n = recvmsg(filp->tx_fd, &msg, MSG_ERRQUEUE| MSG_DONTWAIT);
+		if (n == -1) {
+			/* EAGAIN: queue drained */
+			break;
+		}
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			serr = (struct sock_extended_err *)CMSG_DATA(cmsg);
+			if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				/* the error queue can not be peeked, keep what it said */
+				foreign = serr->ee_errno != 0? serr->ee_errno: EIO;
+				continue;
+			}
+
+			/* ee_info..ee_data is the range of ids done */
+			zcp->zc_copied += (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)? 1: 0;
+			while (zcp->zc_done != zcp->zc_next &&
+					(int)(serr->ee_data - zcp->zc_done) >= 0) {
+				tx_membuf_drop(zcp->zc_bufs[zcp->zc_done++ % zcp->zc_size]);
+				reaped++;
+			}
+		}
+	}
+
+	if (zcp->zc_done == zcp->zc_next && zcp->zc_task != NULL) {
+		tx_task_t *task = zcp->zc_task;
+		zcp->zc_task = NULL;
+		tx_task_active(task, filp);
+	}
+
+	if (foreign != 0) {
+		errno = foreign;
+		return -1;
+	}
+
+	return reaped;
+#else
+	TX_UNUSED(filp);
+	return 0;
+#endif
+}
+
+#if defined(__linux__)
+/* make room for one more id in zc_bufs */
+static int tx_zcopy_reserve(tx_zcopy *zcp)
+{
+	unsigned i, size;
+	tx_membuf **bufs;
+
+	if (zcp->zc_next - zcp->zc_done == zcp->zc_size) {
+		size = max(zcp->zc_size * 2, ZEROCOPY_SLOTS);
+		bufs = (tx_membuf **)malloc(size * sizeof(*bufs));
+		TX_CHECK(bufs != NULL, "grow zero copy ring failure");
+		if (bufs == NULL) {
+			return -1;
+		}
+
+		for (i = zcp->zc_done; i != zcp->zc_next; i++)
+			bufs[i % size] = zcp->zc_bufs[i % zcp->zc_size];
+
+		free(zcp->zc_bufs);
+		zcp->zc_bufs = bufs;
+		zcp->zc_size = size;
+	}
+
+	return 0;
+}
+#endif
+
+int tx_outcb_zsend(tx_aiocb *filp, tx_aiobuf *buf)
+{
+#if defined(__linux__)
+	ssize_t n;
+	tx_zcopy *zcp = filp->tx_zcp;
+
+	if (zcp == NULL || buf->iob_base == NULL ||
+			buf->iob_len < ZEROCOPY_MIN || tx_zcopy_reserve(zcp) != 0) {
+		return tx_outcb_write(filp, buf->iob_buf, buf->iob_len);
+	}
+
+	if (tx_outq_uncork(filp) != 0) {
+		return -1;
+	}
+
+	n = send(filp->tx_fd, buf->iob_buf, buf->iob_len, MSG_ZEROCOPY);
+	if (n == -1 && errno == ENOBUFS) {
+		/* too many notifications outstanding, reap and retry once */
+		tx_aiocb_zreap(filp);
+		n = send(filp->tx_fd, buf->iob_buf, buf->iob_len, MSG_ZEROCOPY);
+		if (n == -1 && errno == ENOBUFS)
+			return tx_outcb_write(filp, buf->iob_buf, buf->iob_len);
+	}
+
+	if (n > 0) {
+		/* the kernel took the next id, it will report it done */
+		zcp->zc_bufs[zcp->zc_next++ % zcp->zc_size] = buf->iob_base;
+		tx_membuf_hold(buf->iob_base);
+	}
+
+	tx_outcb_update(filp, (int)n);
+	return (int)n;
+#else
+	return tx_outcb_write(filp, buf->iob_buf, buf->iob_len);
+#endif
+}
+
 void tx_aincb_active(tx_aiocb *filp, tx_task_t *task)
 {
+	filp->tx_flags &= ~TX_INTIMEOUT;
+	tx_timer_stop(&filp->tx_deadin);
 	return filp->tx_fops->op_active_in(filp, task);
 }
 
 void tx_aincb_stop(tx_aiocb *filp, void *task)
 {
+	tx_timer_stop(&filp->tx_deadin);
 	return filp->tx_fops->op_cancel_in(filp, task);
 }
 
+void tx_aincb_wakeup(tx_aiocb *filp)
+{
+	tx_task_t *task = filp->tx_filterin;
+
+	filp->tx_filterin = NULL;
+	tx_timer_stop(&filp->tx_deadin);
+	tx_task_active(task, filp);
+	return;
+}
+
+static void tx_aincb_expired(void *up)
+{
+	tx_task_t *task;
+	tx_aiocb *filp = (tx_aiocb *)up;
+
+	task = filp->tx_filterin;
+	if (task != NULL) {
+		filp->tx_filterin = NULL;
+		filp->tx_flags |= TX_INTIMEOUT;
+		tx_task_active(task, &filp->tx_deadin);
+	}
+
+	return;
+}
+
+void tx_aincb_deadline(tx_aiocb *filp, tx_task_t *task, unsigned umilsec)
+{
+	tx_aincb_active(filp, task);
+
+	if (filp->tx_filterin == task) {
+		tx_deadline_arm(filp, &filp->tx_deadin, umilsec);
+	}
+
+	return;
+}
+
 void tx_aincb_update(tx_aiocb *filp, int len)
 {
 	if (len >= 0) {
@@ -202,7 +1099,11 @@ void tx_aiocb_init(tx_aiocb *filp, tx_poll_t *poll, int fd)
 	filp->tx_privp = NULL;
 	filp->tx_filterin = NULL;
 	filp->tx_filterout = NULL;
+	filp->tx_zcp = NULL;
+	filp->tx_oqp = NULL;
 	filp->tx_fops = &_generic_fops;
+	tx_timer_init(&filp->tx_deadin, (tx_timer_ring *)NULL, tx_aincb_expired, filp);
+	tx_timer_init(&filp->tx_deadout, (tx_timer_ring *)NULL, tx_outcb_expired, filp);
 
 	if (fd == -1) return;
  
@@ -219,27 +1120,111 @@ void tx_aiocb_init(tx_aiocb *filp, tx_loop_t *loop, int fd)
 	return;
 }
 
+void tx_listen_init(tx_aiocb *filp, tx_poll_t *poll, int fd)
+{
+	tx_aiocb_init(filp, poll, fd);
+	filp->tx_flags |= TX_LISTEN;
+	return;
+}
+
 void tx_listen_init(tx_aiocb *filp, tx_loop_t *loop, int fd)
 {
 	tx_poll_t *poll = tx_poll_get(loop);
 	TX_ASSERT(poll != NULL);
-	tx_aiocb_init(filp, poll, fd);
-	filp->tx_flags |= TX_LISTEN;
+	tx_listen_init(filp, poll, fd);
+	return;
+}
+
+void tx_listen_shared(tx_aiocb *filp, tx_loop_t *loop, int fd)
+{
+	/* the poller apply the registration later, after the flag is set */
+	tx_listen_init(filp, loop, fd);
+	filp->tx_flags |= TX_SHARED;
+	return;
+}
+
+static void tx_listen_count(tx_aiocb *filp, int newfd)
+{
+	tx_poll_stat *stat = &filp->tx_poll->tx_stat;
+
+	if (newfd != -1) {
+		stat->ps_accepts++;
+		return;
+	}
+
+#ifndef WIN32
+	if (errno == EAGAIN)
+		stat->ps_accept_misses++;
+#else
+	if (WSAGetLastError() == WSAEWOULDBLOCK)
+		stat->ps_accept_misses++;
+#endif
 	return;
 }
 
 int  tx_listen_accept(tx_aiocb *filp, struct sockaddr *sa, size_t *outlen)
 {
+	int newfd;
+	tx_poll_op *ops = filp->tx_poll->tx_ops;
+
 #ifndef WIN32
-	socklen_t salen = (outlen? *outlen: 0);
-	int newfd = accept(filp->tx_fd, sa, outlen? &salen: NULL);
-	if (outlen != NULL) *outlen = salen;
+	if (ops->tx_accept != NULL) {
+		newfd = ops->tx_accept(filp, sa, outlen);
+	} else {
+		socklen_t salen = (outlen? *outlen: 0);
+		newfd = accept(filp->tx_fd, sa, outlen? &salen: NULL);
+		if (outlen != NULL) *outlen = salen;
+	}
+
+	tx_listen_count(filp, newfd);
 	tx_aincb_update(filp, newfd);
 	return newfd;
 #else
+	newfd = ops->tx_accept(filp, sa, outlen);
+	tx_listen_count(filp, newfd);
+	return newfd;
+#endif
+}
+
+static int tx_listen_acceptone(tx_aiocb *filp)
+{
+	int newfd;
 	tx_poll_op *ops = filp->tx_poll->tx_ops;
-	return ops->tx_accept(filp, sa, outlen);
+
+	if (ops->tx_accept != NULL) {
+		/* completion based backend hand out non-blocking fds already */
+		return ops->tx_accept(filp, NULL, NULL);
+	}
+
+#if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+	newfd = accept4(filp->tx_fd, NULL, NULL, SOCK_NONBLOCK| SOCK_CLOEXEC);
+#else
+	newfd = accept(filp->tx_fd, NULL, NULL);
+	if (newfd != -1) tx_setblockopt(newfd, 0);
 #endif
+	return newfd;
+}
+
+int  tx_listen_acceptv(tx_aiocb *filp, int newfds[], tx_aiocb *newcbs[], int count)
+{
+	int i;
+	int newfd;
+
+	for (i = 0; i < count; i++) {
+		newfd = tx_listen_acceptone(filp);
+		tx_listen_count(filp, newfd);
+
+		if (newfd == -1) {
+			tx_aincb_update(filp, newfd);
+			break;
+		}
+
+		newfds[i] = newfd;
+		if (newcbs != NULL)
+			tx_aiocb_init(newcbs[i], filp->tx_poll, newfd);
+	}
+
+	return (i > 0? i: -1);
 }
 
 int  tx_aiocb_connect(tx_aiocb *filp, struct sockaddr *sa, size_t len, tx_task_t *t)
@@ -254,7 +1239,23 @@ int  tx_aiocb_connect(tx_aiocb *filp, struct sockaddr *sa, size_t len, tx_task_t
 #endif
 
 #ifndef WIN32
-	error = connect(filp->tx_fd, sa, len);
+	tx_poll_op *ops = filp->tx_poll->tx_ops;
+	if (ops->tx_connect != NULL) {
+		error = ops->tx_connect(filp, sa, len);
+		if (error == -EINPROGRESS) {
+			generic_active_out(filp, t);
+			return error;
+		}
+
+		if (error < 0) {
+			/* the poller return -errno, errno is stale */
+			errno = -error;
+			error = -1;
+		}
+	} else {
+		error = connect(filp->tx_fd, sa, len);
+	}
+
 	if (error == -1 && errno == EINPROGRESS) {
 		filp->tx_flags &= ~(TX_WRITABLE| TX_READABLE);
 		generic_active_out(filp, t);
@@ -274,6 +1275,21 @@ int  tx_aiocb_connect(tx_aiocb *filp, struct sockaddr *sa, size_t len, tx_task_t
 
 void tx_aiocb_fini(tx_aiocb *filp)
 {
+	tx_timer_stop(&filp->tx_deadin);
+	tx_timer_stop(&filp->tx_deadout);
+	tx_outq_free(filp);
+
+	if (filp->tx_zcp != NULL) {
+		tx_zcopy *zcp = filp->tx_zcp;
+		TX_CHECK(zcp->zc_next == zcp->zc_done, "zero copy send still in flight");
+		while (zcp->zc_done != zcp->zc_next)
+			tx_membuf_drop(zcp->zc_bufs[zcp->zc_done++ % zcp->zc_size]);
+		free(zcp->zc_bufs);
+		free(zcp);
+		filp->tx_zcp = NULL;
+		filp->tx_flags &= ~TX_ZEROCOPY;
+	}
+
 	if (filp->tx_fd == -1) return; 
 
 	tx_poll_op *ops = filp->tx_poll->tx_ops;
@@ -39,6 +39,9 @@ static LPFN_CONNECTEX lpConnectEx = NULL;
 #define OVERLAPPED_BIND 0x2
 #define OVERLAPPED_TASK 0x4
 
+#define PORT_SENDVEC 16
+#define PORT_SENDMAX (256 * 1024)
+
 struct wsa_overlapped_t {
 	OVERLAPPED tx_lapped; /* MUST KEEP THIS FIRST */
 	void *tx_ulptr;
@@ -50,6 +53,12 @@ struct tx_overlapped_t {
 	int tx_newfd;
 	tx_aiocb *tx_filp;
 	char tx_cache[8192];
+	/* the overlapped send in flight, tx_sendbufs hold what it reference */
+	int tx_sendnvec;
+	int tx_sendnbuf;
+	size_t tx_sendlen;
+	WSABUF tx_sendvec[PORT_SENDVEC];
+	tx_aiobuf tx_sendbufs[PORT_SENDVEC];
 	LIST_ENTRY(tx_overlapped_t) entries;
 	wsa_overlapped_t tx_send, tx_recv;
 };
@@ -72,6 +81,7 @@ typedef struct tx_completion_port_t {
 
 static WSABUF _tx_wsa_buf = {0, 0};
 static int tx_completion_port_sendout(tx_aiocb *filp, const void *buf, size_t len);
+static int tx_completion_port_sendoutv(tx_aiocb *filp, tx_aiobuf *bufs, size_t count);
 static int tx_completion_port_connect(tx_aiocb *filp, void *buf, size_t len);
 static int tx_completion_port_accept(tx_aiocb *filp, void *buf, size_t *len);
 static void tx_completion_port_pollout(tx_aiocb *filp);
@@ -81,6 +91,7 @@ static void tx_completion_port_detach(tx_aiocb *filp);
 
 static tx_poll_op _completion_port_ops = {
 	tx_sendout: tx_completion_port_sendout,
+	tx_sendoutv: tx_completion_port_sendoutv,
 	tx_connect: tx_completion_port_connect,
 	tx_accept: tx_completion_port_accept,
 	tx_pollout: tx_completion_port_pollout,
@@ -89,56 +100,166 @@ static tx_poll_op _completion_port_ops = {
 	tx_detach: tx_completion_port_detach
 };
 
+static void tx_completion_port_sendput(tx_overlapped_t *olaped)
+{
+	for (int i = 0; i < olaped->tx_sendnbuf; i++)
+		tx_aiobuf_drop(&olaped->tx_sendbufs[i]);
+
+	olaped->tx_sendnbuf = 0;
+	olaped->tx_sendnvec = 0;
+	olaped->tx_sendlen  = 0;
+	return;
+}
+
+/* skip what a short completion already sent */
+static void tx_completion_port_sendskip(tx_overlapped_t *olaped, size_t transfered)
+{
+	int i, j = 0;
+	WSABUF *vec = olaped->tx_sendvec;
+
+	olaped->tx_sendlen -= transfered;
+	for (i = 0; i < olaped->tx_sendnvec; i++) {
+		if (transfered >= vec[i].len) {
+			transfered -= vec[i].len;
+			continue;
+		}
+
+		vec[j].buf = vec[i].buf + transfered;
+		vec[j].len = vec[i].len - transfered;
+		transfered = 0;
+		j++;
+	}
+
+	olaped->tx_sendnvec = j;
+	return;
+}
+
+/* post tx_sendvec as one overlapped WSASend */
+static int tx_completion_port_send(tx_aiocb *filp, tx_overlapped_t *olaped)
+{
+	int error;
+	DWORD _wsa_flags = 0;
+	DWORD _wsa_transfer = 0;
+
+	memset(&olaped->tx_send.tx_lapped, 0, sizeof(olaped->tx_send.tx_lapped));
+	olaped->tx_send.tx_ulptr = olaped;
+
+	error = WSASend(filp->tx_fd, olaped->tx_sendvec, olaped->tx_sendnvec,
+			&_wsa_transfer, _wsa_flags, &olaped->tx_send.tx_lapped, NULL);
+	TX_CHECK(error != SOCKET_ERROR || WSAGetLastError() == WSA_IO_PENDING, "WSASend failure");
+	if (error != SOCKET_ERROR ||
+			WSAGetLastError() == WSA_IO_PENDING) {
+		filp->tx_flags &= ~TX_WRITABLE;
+		filp->tx_flags |= TX_POLLOUT;
+		olaped->tx_refcnt++;
+		TX_ASSERT(olaped->tx_refcnt < 4);
+		return 0;
+	}
+
+	fprintf(stderr, "WSASend failure: %d %d\n", error, WSAGetLastError());
+	tx_completion_port_sendput(olaped);
+	filp->tx_flags &= ~TX_POLLOUT;
+	filp->tx_flags |= TX_WRITABLE;
+	tx_outcb_wakeup(filp);
+	return -1;
+}
+
 int tx_completion_port_sendout(tx_aiocb *filp, const void *buf, size_t len)
 {
 	int error, flags;
-	WSABUF wbuf = {0};
 	tx_overlapped_t *olaped;
 	TX_ASSERT(filp->tx_poll->tx_ops == &_completion_port_ops);
 
 	if ((filp->tx_flags & TX_POLLOUT) == 0x0) {
-		DWORD _wsa_flags = 0;
-		DWORD _wsa_transfer = 0;
 		flags = TX_ATTACHED | TX_DETACHED;
 		TX_ASSERT((filp->tx_flags & flags) == TX_ATTACHED);
 
 		assert(len > 0);
+		len = min(len, INT_MAX);
 		error = send(filp->tx_fd, (const char *)buf, len, 0);
 		if (error > 0) return error;
 
 		olaped = (tx_overlapped_t *)filp->tx_privp;
-		memset(&olaped->tx_send.tx_lapped, 0, sizeof(olaped->tx_send.tx_lapped));
-		olaped->tx_send.tx_ulptr = olaped;
-
 		if (TX_MEMLOCK & filp->tx_flags) {
-			wbuf.buf = (char *)buf;
-			wbuf.len = len;
+			olaped->tx_sendvec[0].buf = (char *)buf;
 		} else if (len <= sizeof(olaped->tx_cache)) {
 			memcpy(olaped->tx_cache, buf, len);
-			wbuf.buf = olaped->tx_cache;
-			wbuf.len = len;
+			olaped->tx_sendvec[0].buf = olaped->tx_cache;
 		} else {
-			fprintf(stderr, "invalid pending: %d %d\n", len, sizeof(olaped->tx_cache));
-			TX_PANIC(1, "invalid sendout data len");
-			return -1;
+			/* too large for the cache, send it from a pool buffer */
+			len = min(len, PORT_SENDMAX);
+			if (tx_aiobuf_alloc(&olaped->tx_sendbufs[0],
+						tx_loop_get(&filp->tx_poll->tx_task), len) != 0) {
+				return -1;
+			}
+
+			memcpy(olaped->tx_sendbufs[0].iob_buf, buf, len);
+			olaped->tx_sendvec[0].buf = olaped->tx_sendbufs[0].iob_buf;
+			olaped->tx_sendnbuf = 1;
 		}
 
-		error = WSASend(filp->tx_fd, &wbuf, 1,
-				&_wsa_transfer, _wsa_flags, &olaped->tx_send.tx_lapped, NULL);
-		TX_CHECK(error != SOCKET_ERROR || WSAGetLastError() == WSA_IO_PENDING, "WSASend failure");
-		if (error != SOCKET_ERROR ||
-				WSAGetLastError() == WSA_IO_PENDING) {
-			filp->tx_flags &= ~TX_WRITABLE;
-			filp->tx_flags |= TX_POLLOUT;
-			olaped->tx_refcnt++;
-			TX_ASSERT(olaped->tx_refcnt < 4);
+		olaped->tx_sendvec[0].len = len;
+		olaped->tx_sendnvec = 1;
+		olaped->tx_sendlen = len;
+		if (tx_completion_port_send(filp, olaped) == 0) {
 			return len;
-		} else {
-			fprintf(stderr, "WSASend failure: %d %d\n", error, WSAGetLastError());
-			filp->tx_flags &= ~TX_POLLOUT;
-			filp->tx_flags |= TX_WRITABLE;
-			tx_task_active(filp->tx_filterout, filp);
-			filp->tx_filterout = NULL;
+		}
+	}
+
+	return -1;
+}
+
+int tx_completion_port_sendoutv(tx_aiocb *filp, tx_aiobuf *bufs, size_t count)
+{
+	int i, error, flags;
+	size_t total = 0;
+	DWORD _wsa_transfer = 0;
+	WSABUF wbufs[PORT_SENDVEC];
+	tx_overlapped_t *olaped;
+	TX_ASSERT(filp->tx_poll->tx_ops == &_completion_port_ops);
+
+	if ((filp->tx_flags & TX_POLLOUT) == 0x0) {
+		flags = TX_ATTACHED | TX_DETACHED;
+		TX_ASSERT((filp->tx_flags & flags) == TX_ATTACHED);
+
+		count = min(count, PORT_SENDVEC);
+		for (i = 0; i < (int)count; i++) {
+			if (total + bufs[i].iob_len > INT_MAX) break;
+			wbufs[i].buf = bufs[i].iob_buf;
+			wbufs[i].len = bufs[i].iob_len;
+			total += bufs[i].iob_len;
+		}
+
+		count = i;
+		error = WSASend(filp->tx_fd, wbufs, count, &_wsa_transfer, 0, NULL, NULL);
+		if (error != SOCKET_ERROR) return _wsa_transfer;
+		if (WSAGetLastError() != WSAEWOULDBLOCK) return -1;
+
+		olaped = (tx_overlapped_t *)filp->tx_privp;
+		for (i = 0; i < (int)count; i++) {
+			tx_aiobuf *iobp = &olaped->tx_sendbufs[i];
+
+			if (bufs[i].iob_base != NULL) {
+				*iobp = bufs[i];
+				tx_aiobuf_hold(iobp);
+			} else if (tx_aiobuf_alloc(iobp,
+						tx_loop_get(&filp->tx_poll->tx_task), bufs[i].iob_len) == 0) {
+				memcpy(iobp->iob_buf, bufs[i].iob_buf, bufs[i].iob_len);
+			} else {
+				olaped->tx_sendnbuf = i;
+				tx_completion_port_sendput(olaped);
+				return -1;
+			}
+
+			olaped->tx_sendvec[i].buf = iobp->iob_buf;
+			olaped->tx_sendvec[i].len = iobp->iob_len;
+		}
+
+		olaped->tx_sendnbuf = count;
+		olaped->tx_sendnvec = count;
+		olaped->tx_sendlen = total;
+		if (tx_completion_port_send(filp, olaped) == 0) {
+			return total;
 		}
 	}
 
@@ -329,8 +450,7 @@ void tx_completion_port_pollin(tx_aiocb *filp)
 			LOG_INFO("completion port is failure: %d %d", WSAGetLastError(), filp->tx_fd);
 			filp->tx_flags &= ~TX_POLLIN;
 			filp->tx_flags |= TX_READABLE;
-			tx_task_active(filp->tx_filterin, filp);
-			filp->tx_filterin = NULL;
+			tx_aincb_wakeup(filp);
 		}
 
 		TX_ASSERT(olaped->tx_refcnt < 4);
@@ -368,25 +488,35 @@ static void handle_overlapped(wsa_overlapped_t *ulptr, DWORD transfered)
 	tx_overlapped_t *olaped;
 	olaped = (tx_overlapped_t *)ulptr->tx_ulptr;
 
+	filp = olaped->tx_filp;
+	if (ulptr == &olaped->tx_send && olaped->tx_sendnvec > 0) {
+		if (filp != NULL && transfered > 0 && transfered < olaped->tx_sendlen) {
+			/* a short overlapped send, post the rest of the same buffers */
+			olaped->tx_refcnt--;
+			tx_completion_port_sendskip(olaped, transfered);
+			tx_completion_port_send(filp, olaped);
+			return;
+		}
+
+		tx_completion_port_sendput(olaped);
+	}
+
 	if (--olaped->tx_refcnt == 0) {
 		LIST_REMOVE(olaped, entries);
 		delete olaped;
 		return;
 	}
 
-	filp = olaped->tx_filp;
 	if (filp != NULL) {
 		if (ulptr == &olaped->tx_send) {
 			filp->tx_flags &= ~TX_POLLOUT;
 			filp->tx_flags |= TX_WRITABLE;
-			tx_task_active(filp->tx_filterout, filp);
-			filp->tx_filterout = NULL;
+			tx_outcb_wakeup(filp);
 		} else if (ulptr == &olaped->tx_recv) {
 			TX_CHECK(transfered == 0, "transfer byte none zero read");
 			filp->tx_flags &= ~TX_POLLIN;
 			filp->tx_flags |= TX_READABLE;
-			tx_task_active(filp->tx_filterin, filp);
-			filp->tx_filterin = NULL;
+			tx_aincb_wakeup(filp);
 		}
 	}
 
@@ -411,14 +541,18 @@ static void tx_completion_port_polling(void *up)
 
 	for ( ; ; ) {
 		timeout = tx_loop_timeout(loop, up)? 15: 0;
+		tx_poll_waitstart(&port->port_poll);
 		result = GetQueuedCompletionStatus(port->port_handle,
 				&transfered_bytes, &completion_key, &overlapped, timeout);
 		if (overlapped == NULL &&
 				result == FALSE && GetLastError() == WAIT_TIMEOUT) {
 			/* LOG_INFO("completion port is clean"); */
+			tx_poll_waitdone(&port->port_poll, 0);
 			break;
 		}
 
+		tx_poll_waitdone(&port->port_poll, overlapped != NULL? 1: -1);
+
 		TX_CHECK(overlapped != NULL, "could not get any event from port");
 		status = (wsa_overlapped_t *)overlapped;
 		handle_overlapped(status, transfered_bytes);
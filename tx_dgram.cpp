@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WIN32)
+#include <winsock2.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/udp.h>
+#endif
+
+#include "txall.h"
+
+#define DGRAM_BATCH 64
+
+#if defined(__linux__)
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#define DGRAM_CMSG CMSG_SPACE(sizeof(int))
+#endif
+
+/* make dgp->dg_buf a private buffer of at least size byte */
+static int tx_dgram_prepare(tx_aiocb *filp, tx_dgram *dgp, size_t size)
+{
+	tx_membuf *mbp = dgp->dg_buf.iob_base;
+
+	if (mbp != NULL && mbp->iob_use == 1 && tx_membuf_size(mbp) >= size) {
+		dgp->dg_buf.iob_buf = (char *)mbp->iob_alloc;
+		dgp->dg_buf.iob_len = size;
+		return 0;
+	}
+
+	tx_aiobuf_drop(&dgp->dg_buf);
+	return tx_aiobuf_alloc(&dgp->dg_buf, tx_loop_get(&filp->tx_poll->tx_task), size);
+}
+
+int tx_dgram_recv(tx_aiocb *filp, tx_dgram dgs[], int count, size_t size)
+{
+	int i, n;
+	int total = 0;
+
+	for (i = 0; i < count; i++) {
+		if (tx_dgram_prepare(filp, &dgs[i], size) != 0) {
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+
+#if defined(__linux__)
+	struct cmsghdr *cmsg;
+	struct iovec iov[DGRAM_BATCH];
+	struct mmsghdr msgs[DGRAM_BATCH];
+	union { char buf[DGRAM_CMSG]; struct cmsghdr align; } ctl[DGRAM_BATCH];
+
+	while (total < count) {
+		int batch = min(count - total, DGRAM_BATCH);
+
+		for (i = 0; i < batch; i++) {
+			tx_dgram *dgp = &dgs[total + i];
+			iov[i].iov_base = dgp->dg_buf.iob_buf;
+			iov[i].iov_len  = dgp->dg_buf.iob_len;
+			memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &dgp->dg_addr;
+			msgs[i].msg_hdr.msg_namelen = sizeof(dgp->dg_addr);
+			msgs[i].msg_hdr.msg_control = ctl[i].buf;
+			msgs[i].msg_hdr.msg_controllen = sizeof(ctl[i].buf);
+		}
+
+		n = recvmmsg(filp->tx_fd, msgs, batch, MSG_DONTWAIT, NULL);
+		if (n <= 0) {
+			tx_aincb_update(filp, n);
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			tx_dgram *dgp = &dgs[total + i];
+			dgp->dg_buf.iob_len = msgs[i].msg_len;
+			dgp->dg_addrlen = msgs[i].msg_hdr.msg_namelen;
+			dgp->dg_segsize = 0;
+
+			cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+			for (; cmsg != NULL; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+				if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+					int segsize;
+					memcpy(&segsize, CMSG_DATA(cmsg), sizeof(segsize));
+					/* a single packet is reported as its own length */
+					if ((size_t)segsize < dgp->dg_buf.iob_len)
+						dgp->dg_segsize = segsize;
+				}
+			}
+		}
+
+		total += n;
+		if (n < batch) {
+			/* short batch, the queue is empty: skip the EAGAIN round trip */
+			filp->tx_flags &= ~TX_READABLE;
+			break;
+		}
+	}
+#else
+	while (total < count) {
+		tx_dgram *dgp = &dgs[total];
+
+		dgp->dg_addrlen = sizeof(dgp->dg_addr);
+		n = recvfrom(filp->tx_fd, dgp->dg_buf.iob_buf, dgp->dg_buf.iob_len, 0,
+				(struct sockaddr *)&dgp->dg_addr, &dgp->dg_addrlen);
+		if (n < 0) {
+			tx_aincb_update(filp, n);
+			break;
+		}
+
+		dgp->dg_buf.iob_len = n;
+		dgp->dg_segsize = 0;
+		total++;
+	}
+#endif
+
+	return total > 0? total: -1;
+}
+
+int tx_dgram_send(tx_aiocb *filp, tx_dgram dgs[], int count)
+{
+	int i, n;
+	int total = 0;
+
+#if defined(__linux__)
+	int j, nmsg;
+	size_t adv, off, len;
+	struct cmsghdr *cmsg;
+	char fin[DGRAM_BATCH];
+	struct iovec iov[DGRAM_BATCH];
+	struct mmsghdr msgs[DGRAM_BATCH];
+	union { char buf[DGRAM_CMSG]; struct cmsghdr align; } ctl[DGRAM_BATCH];
+
+	while (total < count) {
+		nmsg = 0;
+
+		for (j = total; j < count && nmsg < DGRAM_BATCH; j++) {
+			tx_dgram *dgp = &dgs[j];
+			size_t segsize = dgp->dg_segsize;
+
+			if (segsize > 65535) {
+				/* UDP_SEGMENT take a 16 bit size */
+				break;
+			}
+
+			if (segsize == 0 || segsize >= dgp->dg_buf.iob_len)
+				segsize = dgp->dg_buf.iob_len;
+
+			for (off = 0; nmsg < DGRAM_BATCH; off += len) {
+				len = dgp->dg_buf.iob_len - off;
+				if (len > segsize && (filp->tx_flags & TX_UDPGSO) == 0) {
+					/* no segmentation offload: one message per packet */
+					len = segsize;
+				}
+
+				i = nmsg++;
+				iov[i].iov_base = dgp->dg_buf.iob_buf + off;
+				iov[i].iov_len  = len;
+				memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+				msgs[i].msg_hdr.msg_iov = &iov[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+				msgs[i].msg_hdr.msg_name = dgp->dg_addrlen > 0? &dgp->dg_addr: NULL;
+				msgs[i].msg_hdr.msg_namelen = dgp->dg_addrlen;
+				fin[i] = (off + len == dgp->dg_buf.iob_len);
+
+				if (len > segsize) {
+					unsigned short size16 = (unsigned short)segsize;
+					msgs[i].msg_hdr.msg_control = ctl[i].buf;
+					msgs[i].msg_hdr.msg_controllen = sizeof(ctl[i].buf);
+					cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+					cmsg->cmsg_level = SOL_UDP;
+					cmsg->cmsg_type = UDP_SEGMENT;
+					cmsg->cmsg_len = CMSG_LEN(sizeof(size16));
+					memcpy(CMSG_DATA(cmsg), &size16, sizeof(size16));
+				}
+
+				if (fin[i]) {
+					break;
+				}
+			}
+		}
+
+		if (nmsg == 0) {
+			/* dgs[total] has a segment size no kernel accept */
+			errno = EINVAL;
+			break;
+		}
+
+		n = sendmmsg(filp->tx_fd, msgs, nmsg, MSG_DONTWAIT);
+		if (n <= 0) {
+			tx_outcb_update(filp, n);
+			break;
+		}
+
+		adv = 0;
+		for (i = 0; i < n; i++) {
+			adv += iov[i].iov_len;
+			if (fin[i]) {
+				total++;
+				adv = 0;
+			}
+		}
+
+		if (adv > 0) {
+			/* a train sent in part, what is left go with the next call */
+			dgs[total].dg_buf.iob_buf += adv;
+			dgs[total].dg_buf.iob_len -= adv;
+		}
+
+		if (n < nmsg) {
+			break;
+		}
+	}
+#else
+	while (total < count) {
+		tx_dgram *dgp = &dgs[total];
+		size_t len = dgp->dg_buf.iob_len;
+
+		/* no segmentation offload: send the train one packet at a time */
+		if (dgp->dg_segsize > 0 && dgp->dg_segsize < len)
+			len = dgp->dg_segsize;
+
+		n = sendto(filp->tx_fd, dgp->dg_buf.iob_buf, len, 0,
+				dgp->dg_addrlen > 0? (struct sockaddr *)&dgp->dg_addr: NULL, dgp->dg_addrlen);
+		if (n < 0) {
+			tx_outcb_update(filp, n);
+			break;
+		}
+
+		if (len < dgp->dg_buf.iob_len) {
+			dgp->dg_buf.iob_buf += len;
+			dgp->dg_buf.iob_len -= len;
+			continue;
+		}
+
+		total++;
+	}
+#endif
+
+	return total > 0? total: -1;
+}
+
+int tx_dgram_offload(tx_aiocb *filp, int flags)
+{
+	int result = 0;
+
+#if defined(__linux__)
+	int on = 1;
+	socklen_t len = sizeof(on);
+
+	if ((flags & TX_DGRAM_GSO) &&
+			getsockopt(filp->tx_fd, SOL_UDP, UDP_SEGMENT, &on, &len) == 0) {
+		filp->tx_flags |= TX_UDPGSO;
+		result |= TX_DGRAM_GSO;
+	}
+
+	on = 1;
+	if ((flags & TX_DGRAM_GRO) &&
+			setsockopt(filp->tx_fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0) {
+		result |= TX_DGRAM_GRO;
+	}
+#endif
+
+	return result;
+}
+
+int tx_dgram_split(tx_dgram *dgp, tx_dgram segs[], int count)
+{
+	int i;
+	size_t len;
+	tx_membuf *mbp = dgp->dg_buf.iob_base;
+	size_t segsize = dgp->dg_segsize;
+
+	if (segsize == 0)
+		segsize = dgp->dg_buf.iob_len;
+
+	for (i = 0; i < count && dgp->dg_buf.iob_len > 0; i++) {
+		tx_dgram *segp = &segs[i];
+
+		len = min(segsize, dgp->dg_buf.iob_len);
+		tx_aiobuf_drop(&segp->dg_buf);
+		tx_aiobuf_slice(&segp->dg_buf, mbp,
+				dgp->dg_buf.iob_buf - (char *)mbp->iob_alloc, len);
+		segp->dg_segsize = 0;
+		segp->dg_addrlen = dgp->dg_addrlen;
+		memcpy(&segp->dg_addr, &dgp->dg_addr, dgp->dg_addrlen);
+
+		dgp->dg_buf.iob_buf += len;
+		dgp->dg_buf.iob_len -= len;
+	}
+
+	return i;
+}
+
+void tx_dgram_drop(tx_dgram dgs[], int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		tx_aiobuf_drop(&dgs[i].dg_buf);
+
+	return;
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 
 #ifdef __linux__
+#include <poll.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/epoll.h>
@@ -12,13 +13,57 @@
 #include "txall.h"
 
 #define MAX_EVENTS 10
+#define MAX_EVENTS_LIMIT 1024
+#define SHRINK_EVENTS_WAITS 16
+
+#define MAX_CHANGES 64
+#define MIN_SLOTS 64
+
+#define TX_EDGE    (TX_POLLER_PRIVATE << 0)
+#define TX_KERNEL  (TX_POLLER_PRIVATE << 1)
+#define TX_ARMIN   (TX_POLLER_PRIVATE << 2)
+#define TX_ARMOUT  (TX_POLLER_PRIVATE << 3)
+#define TX_CHANGED (TX_POLLER_PRIVATE << 4)
 
 #ifdef __linux__
 
+/*
+ * the event array start with MAX_EVENTS, double when a wait fill it up,
+ * and halve when SHRINK_EVENTS_WAITS waits in a row use less than a quarter.
+ *
+ * interest changes are not sent to the kernel right away, the aiocb is put
+ * on the changelist (TX_CHANGED) and tx_epoll_flush apply its final state
+ * once before epoll_wait: attach + pollin + pollout become one EPOLL_CTL_ADD,
+ * and a change that end with the armed state (TX_ARMIN/TX_ARMOUT) is dropped.
+ *
+ * the epoll data is not the aiocb pointer but (generation << 32 | fd), the
+ * aiocb is found in the fd-indexed slot table. attach and detach bump the
+ * slot generation, so an event still in the returned batch for an aiocb
+ * that was detached (and maybe freed or reused) no longer match, and is
+ * dropped instead of dispatched.
+ */
+typedef struct tx_epoll_slot {
+	unsigned gen;
+	tx_aiocb *filp;
+} tx_epoll_slot;
+
 typedef struct tx_epoll_t {
 	int epoll_fd;
+	int epoll_mode;
 	int epoll_refcnt;
 	tx_poll_t epoll_task;
+
+	int epoll_nevent;
+	int epoll_maxevent;
+	int epoll_lowwait;
+	struct epoll_event *epoll_events;
+
+	int epoll_nchange;
+	int epoll_maxchange;
+	tx_aiocb **epoll_changes;
+
+	int epoll_nslot;
+	tx_epoll_slot *epoll_slots;
 } tx_epoll_t;
 
 static void tx_epoll_pollout(tx_aiocb *filp);
@@ -28,6 +73,7 @@ static void tx_epoll_detach(tx_aiocb *filp);
 
 static tx_poll_op _epoll_ops = {
 	.tx_sendout = NULL,
+	.tx_sendoutv = NULL,
 	.tx_connect = NULL,
 	.tx_accept = NULL,
 	.tx_pollout = tx_epoll_pollout,
@@ -40,17 +86,193 @@ static tx_poll_op _epoll_ops = {
 #define EPOLLONESHOT EPOLLET
 #endif
 
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
 #if 0
 flags = fcntl(filp->tx_fd, F_GETFL);
 fcntl(filp->tx_fd, F_SETFL, flags | O_NONBLOCK);
 #endif
 
-void tx_epoll_pollout(tx_aiocb *filp)
+static void tx_epoll_change(tx_epoll_t *epoll, tx_aiocb *filp)
+{
+	int nchange;
+	tx_aiocb **changes;
+
+	if (filp->tx_flags & TX_CHANGED) {
+		/* merge with the pending change */
+		return;
+	}
+
+	if (epoll->epoll_nchange == epoll->epoll_maxchange) {
+		nchange = max(epoll->epoll_maxchange * 2, MAX_CHANGES);
+		changes = (tx_aiocb **)realloc(epoll->epoll_changes, nchange * sizeof(*changes));
+		TX_PANIC(changes != NULL, "grow epoll changelist failure");
+		epoll->epoll_changes = changes;
+		epoll->epoll_maxchange = nchange;
+	}
+
+	epoll->epoll_changes[epoll->epoll_nchange++] = filp;
+	filp->tx_flags |= TX_CHANGED;
+	return;
+}
+
+static void tx_epoll_unchange(tx_epoll_t *epoll, tx_aiocb *filp)
 {
+	int i;
+
+	if (filp->tx_flags & TX_CHANGED) {
+		for (i = 0; i < epoll->epoll_nchange; i++) {
+			if (epoll->epoll_changes[i] == filp) {
+				epoll->epoll_changes[i] = epoll->epoll_changes[--epoll->epoll_nchange];
+				break;
+			}
+		}
+
+		filp->tx_flags &= ~TX_CHANGED;
+	}
+
+	return;
+}
+
+static void tx_epoll_bind(tx_epoll_t *epoll, tx_aiocb *filp)
+{
+	int nslot;
+	int fd = filp->tx_fd;
+	tx_epoll_slot *slots;
+
+	if (fd < 0) {
+		/* epoll_ctl will refuse it anyway */
+		return;
+	}
+
+	if (fd >= epoll->epoll_nslot) {
+		nslot = max(epoll->epoll_nslot, MIN_SLOTS);
+		while (nslot <= fd) nslot *= 2;
+		slots = (tx_epoll_slot *)realloc(epoll->epoll_slots, nslot * sizeof(*slots));
+		TX_PANIC(slots != NULL, "grow epoll slot table failure");
+		memset(slots + epoll->epoll_nslot, 0, (nslot - epoll->epoll_nslot) * sizeof(*slots));
+		epoll->epoll_slots = slots;
+		epoll->epoll_nslot = nslot;
+	}
+
+	epoll->epoll_slots[fd].gen++;
+	epoll->epoll_slots[fd].filp = filp;
+	return;
+}
+
+static void tx_epoll_unbind(tx_epoll_t *epoll, tx_aiocb *filp)
+{
+	int fd = filp->tx_fd;
+
+	if (fd >= 0 && fd < epoll->epoll_nslot &&
+			epoll->epoll_slots[fd].filp == filp) {
+		epoll->epoll_slots[fd].gen++;
+		epoll->epoll_slots[fd].filp = NULL;
+	}
+
+	return;
+}
+
+static tx_aiocb *tx_epoll_lookup(tx_epoll_t *epoll, uint64_t data)
+{
+	tx_epoll_slot *slot;
+	unsigned fd = (unsigned)data;
+
+	if (fd < (unsigned)epoll->epoll_nslot) {
+		slot = &epoll->epoll_slots[fd];
+		if (slot->gen == (unsigned)(data >> 32))
+			return slot->filp;
+	}
+
+	return NULL;
+}
+
+static void tx_epoll_apply(tx_epoll_t *epoll, tx_aiocb *filp)
+{
+	int op;
 	int error;
-	int flags, tflag;
-	tx_epoll_t *epoll;
+	unsigned gen;
+	int armed, wanted;
 	epoll_event event = {0};
+
+	armed  = (filp->tx_flags & TX_ARMIN)? EPOLLIN: 0;
+	armed |= (filp->tx_flags & TX_ARMOUT)? EPOLLOUT: 0;
+
+	if ((filp->tx_flags & (TX_LISTEN| TX_SHARED| TX_KERNEL)) == (TX_LISTEN| TX_SHARED)) {
+		/*
+		 * EPOLLEXCLUSIVE is only allowed with EPOLL_CTL_ADD and without
+		 * EPOLLONESHOT, so shared listeners always take the edge path.
+		 */
+		filp->tx_flags |= TX_EDGE;
+		wanted = EPOLLIN;
+		event.events = EPOLLIN| EPOLLET| EPOLLEXCLUSIVE;
+	} else if (filp->tx_flags & TX_EDGE) {
+		wanted = EPOLLIN| EPOLLOUT;
+		event.events = EPOLLIN| EPOLLOUT| EPOLLET;
+	} else {
+		wanted  = (filp->tx_flags & TX_POLLIN)? EPOLLIN: 0;
+		wanted |= (filp->tx_flags & TX_POLLOUT)? EPOLLOUT: 0;
+		event.events = wanted | (wanted? EPOLLONESHOT: 0);
+	}
+
+	op = (filp->tx_flags & TX_KERNEL)? EPOLL_CTL_MOD: EPOLL_CTL_ADD;
+	if (op == EPOLL_CTL_MOD && armed == wanted &&
+			(wanted != 0 || (filp->tx_flags & TX_ZEROCOPY) == 0)) {
+		/* redundant change, kernel state is already right */
+		return;
+	}
+
+	gen = (filp->tx_fd >= 0 && filp->tx_fd < epoll->epoll_nslot)? epoll->epoll_slots[filp->tx_fd].gen: 0;
+	event.data.u64 = ((uint64_t)gen << 32) | (unsigned)filp->tx_fd;
+	epoll->epoll_task.tx_stat.ps_ctl_add += (op == EPOLL_CTL_ADD);
+	epoll->epoll_task.tx_stat.ps_ctl_mod += (op == EPOLL_CTL_MOD);
+	error = epoll_ctl(epoll->epoll_fd, op, filp->tx_fd, &event);
+	if (error == 0) {
+		filp->tx_flags &= ~(TX_ARMIN| TX_ARMOUT);
+		filp->tx_flags |= TX_KERNEL;
+		filp->tx_flags |= (wanted & EPOLLIN)? TX_ARMIN: 0;
+		filp->tx_flags |= (wanted & EPOLLOUT)? TX_ARMOUT: 0;
+		return;
+	}
+
+	epoll->epoll_task.tx_stat.ps_failures++;
+	if (op == EPOLL_CTL_ADD && errno == EPERM) {
+		LOG_DEBUG("fd is not epollable");
+		if (filp->tx_flags & (TX_POLLIN| TX_POLLOUT))
+			epoll->epoll_refcnt--;
+		filp->tx_flags &= ~(TX_POLLIN| TX_POLLOUT);
+		filp->tx_flags |= (TX_READABLE| TX_WRITABLE);
+		tx_outcb_wakeup(filp);
+		tx_aincb_wakeup(filp);
+		return;
+	}
+
+	LOG_DEBUG("epoll ctl %d failure %d, %s", op, errno, strerror(errno));
+	TX_CHECK(error == 0, "epoll ctl apply failure");
+	return;
+}
+
+static void tx_epoll_flush(tx_epoll_t *epoll)
+{
+	int i;
+	tx_aiocb *filp;
+
+	for (i = 0; i < epoll->epoll_nchange; i++) {
+		filp = epoll->epoll_changes[i];
+		filp->tx_flags &= ~TX_CHANGED;
+		tx_epoll_apply(epoll, filp);
+	}
+
+	epoll->epoll_nchange = 0;
+	return;
+}
+
+void tx_epoll_pollout(tx_aiocb *filp)
+{
+	int flags;
+	tx_epoll_t *epoll;
 	epoll = container_of(filp->tx_poll, tx_epoll_t, epoll_task);
 	TX_ASSERT(filp->tx_poll->tx_ops == &_epoll_ops);
 
@@ -58,14 +280,12 @@ void tx_epoll_pollout(tx_aiocb *filp)
 		flags = TX_ATTACHED | TX_DETACHED;
 		TX_ASSERT((filp->tx_flags & flags) == TX_ATTACHED);
 
-		tflag = (filp->tx_flags & TX_POLLIN);
-		event.events   = (tflag? EPOLLIN: 0) | EPOLLOUT | EPOLLONESHOT;
-		event.data.ptr = filp;
+		epoll->epoll_refcnt += ((filp->tx_flags & TX_POLLIN) == 0);
+		filp->tx_flags |= TX_POLLOUT;
 
-		error = epoll_ctl(epoll->epoll_fd, EPOLL_CTL_MOD, filp->tx_fd, &event);
-		epoll->epoll_refcnt += (error == 0 && tflag == 0);
-		filp->tx_flags |= (error == 0? TX_POLLOUT: 0);
-		TX_CHECK(error == 0, "epoll ctl pollout failure");
+		/* edge registration is persistent, no change needed */
+		if ((filp->tx_flags & TX_EDGE) == 0)
+			tx_epoll_change(epoll, filp);
 	}
 
 #ifndef DISABLE_MULTI_POLLER
@@ -81,10 +301,8 @@ void tx_epoll_pollout(tx_aiocb *filp)
 
 void tx_epoll_attach(tx_aiocb *filp)
 {
-	int error;
 	int flags, tflag;
 	tx_epoll_t *epoll;
-	epoll_event event = {0};
 	epoll = container_of(filp->tx_poll, tx_epoll_t, epoll_task);
 	TX_ASSERT(filp->tx_poll->tx_ops == &_epoll_ops);
 
@@ -92,18 +310,11 @@ void tx_epoll_attach(tx_aiocb *filp)
 	tflag = (filp->tx_flags & flags);
 
 	if (tflag == 0 || tflag == flags) {
-
-		event.data.ptr = filp;
-		error = epoll_ctl(epoll->epoll_fd, EPOLL_CTL_ADD, filp->tx_fd, &event);
-		filp->tx_flags &= ~(error == 0? TX_DETACHED: 0);
-		filp->tx_flags |= (error == 0? TX_ATTACHED: 0);
-		TX_CHECK(error == 0, "epoll ctl attach failure");
-
-		if (error == -1 && errno == EPERM) {
-			LOG_DEBUG("fd is not epollable");
-			filp->tx_flags |= TX_WRITABLE;
-			filp->tx_flags |= TX_READABLE;
-		}
+		filp->tx_flags &= ~(TX_DETACHED| TX_EDGE| TX_KERNEL| TX_ARMIN| TX_ARMOUT| TX_CHANGED);
+		filp->tx_flags |= TX_ATTACHED;
+		filp->tx_flags |= (epoll->epoll_mode == TX_EPOLL_EDGE? TX_EDGE: 0);
+		tx_epoll_bind(epoll, filp);
+		tx_epoll_change(epoll, filp);
 	}
 
 	return;
@@ -111,10 +322,8 @@ void tx_epoll_attach(tx_aiocb *filp)
 
 void tx_epoll_pollin(tx_aiocb *filp)
 {
-	int error;
-	int flags, tflag;
+	int flags;
 	tx_epoll_t *epoll;
-	epoll_event event = {0};
 	epoll = container_of(filp->tx_poll, tx_epoll_t, epoll_task);
 	TX_ASSERT(filp->tx_poll->tx_ops == &_epoll_ops);
 
@@ -122,14 +331,12 @@ void tx_epoll_pollin(tx_aiocb *filp)
 		flags = TX_ATTACHED | TX_DETACHED;
 		TX_ASSERT((filp->tx_flags & flags) == TX_ATTACHED);
 
-		tflag = (filp->tx_flags & TX_POLLOUT);
-		event.events   = (tflag? EPOLLOUT: 0) | EPOLLIN | EPOLLONESHOT;
-		event.data.ptr = filp;
+		epoll->epoll_refcnt += ((filp->tx_flags & TX_POLLOUT) == 0);
+		filp->tx_flags |= TX_POLLIN;
 
-		error = epoll_ctl(epoll->epoll_fd, EPOLL_CTL_MOD, filp->tx_fd, &event);
-		epoll->epoll_refcnt += (error == 0 && tflag == 0);
-		filp->tx_flags |= (error == 0? TX_POLLIN: 0);
-		TX_CHECK(error == 0, "epoll ctl pollin failure");
+		/* edge registration is persistent, no change needed */
+		if ((filp->tx_flags & TX_EDGE) == 0)
+			tx_epoll_change(epoll, filp);
 	}
 
 #ifndef DISABLE_MULTI_POLLER
@@ -154,13 +361,20 @@ void tx_epoll_detach(tx_aiocb *filp)
 
 	flags = TX_ATTACHED| TX_DETACHED;
 	if ((filp->tx_flags & flags) == TX_ATTACHED) {
-		event.data.ptr = filp;
-		error = epoll_ctl(epoll->epoll_fd, EPOLL_CTL_DEL, filp->tx_fd, &event);
-		filp->tx_flags |= (error == 0? TX_DETACHED: 0);
-
-		if (error != 0) {
-			LOG_DEBUG("epoll ctl detach failure %d, %s", errno, strerror(errno));
-			TX_CHECK(error == 0, "epoll ctl detach failure");
+		tx_epoll_unchange(epoll, filp);
+		tx_epoll_unbind(epoll, filp);
+		filp->tx_flags |= TX_DETACHED;
+
+		if (filp->tx_flags & TX_KERNEL) {
+			error = epoll_ctl(epoll->epoll_fd, EPOLL_CTL_DEL, filp->tx_fd, &event);
+			filp->tx_flags &= ~(TX_KERNEL| TX_ARMIN| TX_ARMOUT);
+			epoll->epoll_task.tx_stat.ps_ctl_del++;
+
+			if (error != 0) {
+				epoll->epoll_task.tx_stat.ps_failures++;
+				LOG_DEBUG("epoll ctl detach failure %d, %s", errno, strerror(errno));
+				TX_CHECK(error == 0, "epoll ctl detach failure");
+			}
 		}
 	}
 
@@ -180,71 +394,172 @@ void tx_epoll_detach(tx_aiocb *filp)
 
 static void tx_epoll_pollit(tx_epoll_t *epoll, tx_aiocb *filp)
 {
-	int error;
-	int flin, flout;
-	int flags = filp->tx_flags;
-	epoll_event event = {0};
+	epoll->epoll_refcnt++;
+	tx_epoll_change(epoll, filp);
+	return;
+}
+
+static void tx_epoll_edge(tx_epoll_t *poll, tx_aiocb *filp, int events)
+{
+	int flags = TX_POLLIN| TX_POLLOUT;
+	int waiting = (filp->tx_flags & flags);
+
+	if (events & (EPOLLHUP| EPOLLERR)) {
+		filp->tx_flags &= ~(TX_POLLIN| TX_POLLOUT);
+		filp->tx_flags |= (TX_READABLE| TX_WRITABLE);
+		tx_outcb_wakeup(filp);
+		tx_aincb_wakeup(filp);
+	}
+
+	if (events & EPOLLOUT) {
+		filp->tx_flags |= TX_WRITABLE;
+		if (filp->tx_flags & TX_POLLOUT) {
+			filp->tx_flags &= ~TX_POLLOUT;
+			tx_outcb_wakeup(filp);
+		}
+	}
+
+	if (events & EPOLLIN) {
+		filp->tx_flags |= TX_READABLE;
+		if (filp->tx_flags & TX_POLLIN) {
+			filp->tx_flags &= ~TX_POLLIN;
+			tx_aincb_wakeup(filp);
+		}
+	}
+
+	/* edge event also come for fd nobody wait on */
+	if (waiting && (filp->tx_flags & flags) == 0)
+		poll->epoll_refcnt--;
+
+	return;
+}
+
+static void tx_epoll_resize(tx_epoll_t *poll, int nevent)
+{
+	struct epoll_event *events;
+
+	events = (struct epoll_event *)realloc(poll->epoll_events, nevent * sizeof(*events));
+	TX_CHECK(events != NULL, "resize epoll events failure");
+
+	if (events != NULL) {
+		poll->epoll_events = events;
+		poll->epoll_nevent = nevent;
+	}
+
+	poll->epoll_lowwait = 0;
+	return;
+}
 
-	flin = (flags & TX_POLLIN);
-	flout = (flags & TX_POLLOUT);
+static void tx_epoll_adapt(tx_epoll_t *poll, int nfds)
+{
+	int nevent = poll->epoll_nevent;
 
-	event.events = (flin? EPOLLIN: 0) | (flout? EPOLLOUT: 0) | EPOLLONESHOT;
-	event.data.ptr = filp;
-	error = epoll_ctl(epoll->epoll_fd, EPOLL_CTL_MOD, filp->tx_fd, &event);
-	epoll->epoll_refcnt += (error == 0? 1: 0);
-	filp->tx_flags |= (error == 0? flout: 0);
-	filp->tx_flags |= (error == 0? flin: 0);
-	TX_CHECK(error == 0, "epoll ctl pollit failure");
+	if (nfds == nevent && nevent < poll->epoll_maxevent) {
+		tx_epoll_resize(poll, min(nevent * 2, poll->epoll_maxevent));
+		return;
+	}
 
+	if (nfds < nevent / 4 && nevent > MAX_EVENTS) {
+		if (++poll->epoll_lowwait >= SHRINK_EVENTS_WAITS)
+			tx_epoll_resize(poll, max(nevent / 2, MAX_EVENTS));
+		return;
+	}
+
+	poll->epoll_lowwait = 0;
 	return;
 }
 
+/*
+ * the fd is still in error once its error queue is reaped: a socket error
+ * is pending. poll does not consume it like SO_ERROR would, the next read
+ * or write still get it.
+ */
+static int tx_epoll_inerror(int fd)
+{
+	struct pollfd pfd;
+
+	pfd.fd = fd;
+	pfd.events = 0;
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, 0) == -1)
+		return 1;
+
+	return (pfd.revents & POLLERR) != 0;
+}
+
 static void tx_epoll_polling(void *up)
 {
 	int i;
 	int nfds;
+	int waiting;
 	int timeout;
 	tx_loop_t *loop;
 	tx_epoll_t *poll;
-	struct epoll_event events[MAX_EVENTS];
+	struct epoll_event *events;
 
 	poll = (tx_epoll_t *)up;
 	loop = tx_loop_get(&poll->epoll_task.tx_task);
 	timeout = tx_loop_timeout(loop, poll);
 
-	nfds = epoll_wait(poll->epoll_fd, events, MAX_EVENTS, timeout? 10: 0);
+	tx_epoll_flush(poll);
+	events = poll->epoll_events;
+	tx_poll_waitstart(&poll->epoll_task);
+	nfds = epoll_wait(poll->epoll_fd, events, poll->epoll_nevent, timeout? 10: 0);
+	tx_poll_waitdone(&poll->epoll_task, nfds);
 	if (nfds == -1 && errno != 0) fprintf(stderr, "errno %d\n", errno);
 	TX_PANIC(nfds != -1 || errno == EAGAIN || errno == EINTR, "epoll_wait");
 
 	for (i = 0; i < nfds; ++i) {
 		int flags = events[i].events;
-		tx_aiocb *filp = (tx_aiocb *)events[i].data.ptr;
+		tx_aiocb *filp = tx_epoll_lookup(poll, events[i].data.u64);
+
+		if (filp == NULL) {
+			/* detached since the wait returned */
+			poll->epoll_task.tx_stat.ps_stale_events++;
+			continue;
+		}
+
+		if ((flags & (EPOLLERR| EPOLLHUP)) == EPOLLERR &&
+				(filp->tx_flags & TX_ZEROCOPY) && tx_aiocb_zreap(filp) > 0 &&
+				!tx_epoll_inerror(filp->tx_fd)) {
+			/* only zero copy completions on the error queue */
+			flags &= ~EPOLLERR;
+		}
+
+		if (filp->tx_flags & TX_EDGE) {
+			tx_epoll_edge(poll, filp, flags);
+			continue;
+		}
+
+		waiting = (filp->tx_flags & (TX_POLLIN| TX_POLLOUT));
+		if (waiting == 0 && (flags & (EPOLLIN| EPOLLOUT| EPOLLERR| EPOLLHUP)) == 0) {
+			/* error queue of a fd nobody wait on, its registration is not oneshot */
+			continue;
+		}
 
-		poll->epoll_refcnt--; 
+		poll->epoll_refcnt -= (waiting != 0);
+		filp->tx_flags &= ~(TX_ARMIN| TX_ARMOUT);
 
 		//LOG_DEBUG("nr epoll_pwait %d %x", poll->epoll_refcnt, flags);
 		if (flags & (EPOLLHUP| EPOLLERR)) {
 			filp->tx_flags &= ~(TX_POLLIN| TX_POLLOUT);
 			filp->tx_flags |= (TX_READABLE| TX_WRITABLE);
-			tx_task_active(filp->tx_filterout, filp);
-			filp->tx_filterout = NULL;
-			tx_task_active(filp->tx_filterin, filp);
-			filp->tx_filterin = NULL;
+			tx_outcb_wakeup(filp);
+			tx_aincb_wakeup(filp);
 			continue;
 		}
 
 		if (flags & EPOLLOUT) {
 			filp->tx_flags &= ~TX_POLLOUT;
-			tx_task_active(filp->tx_filterout, filp);
+			tx_outcb_wakeup(filp);
 			filp->tx_flags |= TX_WRITABLE;
-			filp->tx_filterout = NULL;
 		}
 
 		if (flags & EPOLLIN) {
 			filp->tx_flags &= ~TX_POLLIN;
-			tx_task_active(filp->tx_filterin, filp);
+			tx_aincb_wakeup(filp);
 			filp->tx_flags |= TX_READABLE;
-			filp->tx_filterin = NULL;
 		}
 
 		flags = TX_POLLIN| TX_POLLOUT;
@@ -252,6 +567,11 @@ static void tx_epoll_polling(void *up)
 			tx_epoll_pollit(poll, filp);
 			continue;
 		}
+
+		if ((filp->tx_flags & TX_ZEROCOPY) && tx_outcb_zpending(filp) > 0) {
+			/* the oneshot fire disabled the fd, keep the error queue reported */
+			tx_epoll_change(poll, filp);
+		}
 	}
 
 #ifndef DISABLE_MULTI_POLLER
@@ -260,11 +580,52 @@ static void tx_epoll_polling(void *up)
 		loop->tx_holder = NULL;
 #endif
 
+	if (nfds >= 0) {
+		tx_epoll_adapt(poll, nfds);
+	}
+
 	tx_poll_active(&poll->epoll_task);
 	return;
 }
 #endif
 
+int tx_epoll_mode(tx_poll_t *poll, int mode)
+{
+#ifdef __linux__
+	int oldmode;
+	tx_epoll_t *epoll;
+	TX_ASSERT(poll->tx_ops == &_epoll_ops);
+	epoll = container_of(poll, tx_epoll_t, epoll_task);
+
+	oldmode = epoll->epoll_mode;
+	epoll->epoll_mode = mode;
+	return oldmode;
+#else
+	TX_UNUSED(poll);
+	TX_UNUSED(mode);
+	return -1;
+#endif
+}
+
+int tx_epoll_maxevents(tx_poll_t *poll, int maxevents)
+{
+#ifdef __linux__
+	tx_epoll_t *epoll;
+	TX_ASSERT(poll->tx_ops == &_epoll_ops);
+	epoll = container_of(poll, tx_epoll_t, epoll_task);
+
+	epoll->epoll_maxevent = max(maxevents, MAX_EVENTS);
+	if (epoll->epoll_nevent > epoll->epoll_maxevent)
+		tx_epoll_resize(epoll, epoll->epoll_maxevent);
+
+	return epoll->epoll_maxevent;
+#else
+	TX_UNUSED(poll);
+	TX_UNUSED(maxevents);
+	return -1;
+#endif
+}
+
 tx_poll_t * tx_epoll_init(tx_loop_t *loop)
 {
 	int fd = -1;
@@ -288,7 +649,10 @@ tx_poll_t * tx_epoll_init(tx_loop_t *loop)
 	fd = epoll_create(10);
 	TX_CHECK(fd != -1, "create epoll failure");
 
-	if (poll != NULL && fd != -1) {
+	struct epoll_event *events = (struct epoll_event *)malloc(MAX_EVENTS * sizeof(*events));
+	TX_CHECK(events != NULL, "create epoll events failure");
+
+	if (poll != NULL && fd != -1 && events != NULL) {
 		tx_poll_init(&poll->epoll_task, loop, tx_epoll_polling, poll);
 		tx_poll_active(&poll->epoll_task);
 		poll->epoll_task.tx_ops = &_epoll_ops;
@@ -297,10 +661,21 @@ tx_poll_t * tx_epoll_init(tx_loop_t *loop)
 		loop->tx_holder = poll;
 #endif
 		poll->epoll_refcnt = 0;
+		poll->epoll_mode = TX_EPOLL_ONESHOT;
 		poll->epoll_fd = fd;
+		poll->epoll_events = events;
+		poll->epoll_nevent = MAX_EVENTS;
+		poll->epoll_maxevent = MAX_EVENTS_LIMIT;
+		poll->epoll_lowwait = 0;
+		poll->epoll_nchange = 0;
+		poll->epoll_maxchange = 0;
+		poll->epoll_changes = NULL;
+		poll->epoll_nslot = 0;
+		poll->epoll_slots = NULL;
 		return &poll->epoll_task;
 	}
 
+	free(events);
 	free(poll);
 	close(fd);
 #endif
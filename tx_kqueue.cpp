@@ -33,6 +33,7 @@ static void tx_kqueue_detach(tx_aiocb *filp);
 
 static tx_poll_op _kqueue_ops = {
 	.tx_sendout = NULL,
+	.tx_sendoutv = NULL,
 	.tx_connect = NULL,
 	.tx_accept = NULL,
 	.tx_pollout = tx_kqueue_pollout,
@@ -62,6 +63,8 @@ void tx_kqueue_pollout(tx_aiocb *filp)
 		event0.filter = EVFILT_WRITE;
 
 		error = kevent(epoll->kqueue_fd, &event0, 1, NULL, 0, NULL);
+		epoll->kqueue_poll.tx_stat.ps_ctl_add++;
+		epoll->kqueue_poll.tx_stat.ps_failures += (error == -1);
 		epoll->epoll_refcnt += (error != -1);
 		filp->tx_flags |= (error != -1? TX_POLLOUT: 0);
 		TX_CHECK(error != -1, "kqueue kevent pollout failure");
@@ -118,6 +121,8 @@ void tx_kqueue_pollin(tx_aiocb *filp)
 		event0.filter = EVFILT_READ;
 
 		error = kevent(epoll->kqueue_fd, &event0, 1, NULL, 0, NULL);
+		epoll->kqueue_poll.tx_stat.ps_ctl_add++;
+		epoll->kqueue_poll.tx_stat.ps_failures += (error == -1);
 		epoll->epoll_refcnt += (error != -1);
 		filp->tx_flags |= (error != -1? TX_POLLIN: 0);
 		TX_CHECK(error != -1, "kevent pollin failure");
@@ -170,6 +175,8 @@ void tx_kqueue_detach(tx_aiocb *filp)
 		error = 0;
 		if (nevent > 0) {
 			error = kevent(epoll->kqueue_fd, events, nevent, NULL, 0, NULL);
+			epoll->kqueue_poll.tx_stat.ps_ctl_del++;
+			epoll->kqueue_poll.tx_stat.ps_failures += (error == -1);
 			TX_CHECK(error != -1, "kevent pollin failure");
 		}
 
@@ -205,7 +212,9 @@ static void tx_kqueue_polling(void *up)
 	loop = tx_loop_get(&poll->kqueue_poll.tx_task);
 	timeout = tx_loop_timeout(loop, poll);
 
+	tx_poll_waitstart(&poll->kqueue_poll);
 	nfds = kevent(poll->kqueue_fd, NULL, 0, events, MAX_EVENTS, timeout? &onetime: &zerotime);
+	tx_poll_waitdone(&poll->kqueue_poll, nfds);
 	TX_PANIC(nfds != -1, "kevent");
 
 	for (i = 0; i < nfds; ++i) {
@@ -215,17 +224,15 @@ static void tx_kqueue_polling(void *up)
 		poll->epoll_refcnt--; 
 
 		if (flags == EVFILT_READ) {
-			tx_task_active(filp->tx_filterin, filp);
+			tx_aincb_wakeup(filp);
 			filp->tx_flags |= TX_READABLE;
-			filp->tx_filterin = NULL;
 			filp->tx_flags &= ~TX_POLLIN;
 			continue;
 		}
 
 		if (flags == EVFILT_WRITE) {
-			tx_task_active(filp->tx_filterout, filp);
+			tx_outcb_wakeup(filp);
 			filp->tx_flags |= TX_WRITABLE;
-			filp->tx_filterout = NULL;
 			filp->tx_flags &= ~TX_POLLOUT;
 			continue;
 		}
@@ -14,6 +14,7 @@ struct tx_loop_t * tx_loop_default(void)
 
 	if (_init == 0) {
 		LIST_INIT(&_default_loop.tx_taskq);
+		LIST_INIT(&_default_loop.tx_deferq);
 		LIST_INSERT_HEAD(&_default_loop.tx_taskq,
 				&_default_loop.tx_tailer, entries);
 		_init = 1;
@@ -80,14 +81,16 @@ tx_loop_t *tx_loop_new(void)
 {
 	tx_loop_t *up;
 	up = (struct tx_loop_t *)malloc(sizeof(*up));
-	TX_CHECK(up == NULL, "allocate memory failure");
+	TX_CHECK(up != NULL, "allocate memory failure");
 
 	if (up != NULL) {
 		memset(up, 0, sizeof(*up));
 		LIST_INIT(&up->tx_taskq);
+		LIST_INIT(&up->tx_deferq);
 		LIST_INSERT_HEAD(&up->tx_taskq, &up->tx_tailer, entries);
 		up->tx_holder = NULL;
 		up->tx_poller = NULL;
+		up->tx_mempool = NULL;
 		up->tx_break = 0;
 		up->tx_stop = 0;
 		up->tx_busy = 0;
@@ -141,6 +144,7 @@ void tx_task_drop(tx_task_t *task)
 void tx_loop_main(tx_loop_t *up)
 {
 	int dirty = 1;
+	int deferred = 0;
 	int first_run = 1;
 
 	tx_task_t phony;
@@ -151,6 +155,14 @@ void tx_loop_main(tx_loop_t *up)
 		tx_task_t *task = taskq->lh_first;
 		LIST_REMOVE(task, entries);
 		if (task == &phony) {
+			if (!LIST_EMPTY(&up->tx_deferq) && !deferred) {
+				/* deferred tasks still belong to this pass, once */
+				deferred = 1;
+				tx_task_wakeup(&up->tx_deferq, up);
+				LIST_INSERT_BEFORE(&up->tx_tailer, &phony, entries);
+				continue;
+			}
+
 			LIST_INSERT_BEFORE(&up->tx_tailer, &phony, entries);
 			if (up->tx_busy & 0x01) {
 				/* XXX */
@@ -160,6 +172,7 @@ void tx_loop_main(tx_loop_t *up)
 			up->tx_busy <<= 1;
 			up->tx_upcount++;
 			first_run = 0;
+			deferred = 0;
 
 			if (up->tx_break) {
 				up->tx_break = 0;
@@ -199,6 +212,15 @@ void tx_loop_stop(tx_loop_t *up)
 	return;
 }
 
+void tx_loop_defer(tx_loop_t *up, tx_task_t *task)
+{
+	if ((task->tx_flags & TASK_PENDING) == 0) {
+		tx_task_record(&up->tx_deferq, task);
+	}
+
+	return;
+}
+
 int  tx_loop_timeout(tx_loop_t *up, const void *verify)
 {
     if ((up->tx_busy & 0x3)
@@ -206,6 +228,8 @@ int  tx_loop_timeout(tx_loop_t *up, const void *verify)
         return 0;
     if (up->tx_break > 0)
         return 0;
+    if (!LIST_EMPTY(&up->tx_deferq))
+        return 0;
     if (up->tx_holder == NULL)
         return 10000;
 	if (up->tx_holder == verify)
@@ -220,6 +244,7 @@ void tx_loop_delete(tx_loop_t *up)
 		tx_task_t *task = taskq->lh_first;
 		TX_CHECK(task != NULL, "loop not empty");
 		task = task; //avoid warning
+		tx_mempool_free(up);
 		free(up);
 	}
 
@@ -78,6 +78,18 @@ int get_target_address(struct tcpip_info *info, const char *address)
 	return 0;
 }
 
+int tx_log2_slot(unsigned int value, int nslot)
+{
+	int slot = 0;
+
+	while (value > 0 && slot + 1 < nslot) {
+		value >>= 1;
+		slot++;
+	}
+
+	return slot;
+}
+
 volatile unsigned int tx_ticks = 0;
 
 #ifdef __MACH__
@@ -118,6 +130,37 @@ unsigned int tx_getticks(void)
 #endif
 }
 
+unsigned long long tx_getusecs(void)
+{
+#if defined(__linux__) || defined(__FreeBSD__)
+	int err;
+	struct timespec ts; 
+
+	err = clock_gettime(CLOCK_MONOTONIC, &ts);
+	TX_CHECK(err == 0, "clock_gettime failure");
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+
+#elif defined(WIN32)
+	LARGE_INTEGER now = {0};
+	static LARGE_INTEGER frequency = {0};
+
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+
+	QueryPerformanceCounter(&now);
+	return (now.QuadPart / frequency.QuadPart) * 1000000ULL +
+		(now.QuadPart % frequency.QuadPart) * 1000000ULL / frequency.QuadPart;
+#elif defined(__APPLE__)
+	clock_serv_t cclock;
+	mach_timespec_t ts;
+	host_get_clock_service(mach_host_self(), SYSTEM_CLOCK, &cclock);
+	clock_get_time(cclock, &ts);
+	mach_port_deallocate(mach_task_self(), cclock);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+#endif
+}
+
 #if defined(WIN32)
 #define ABORTON(cond) if (cond) goto clean
 static int inet_pton4(const char *src, unsigned char *dst);
@@ -12,6 +12,51 @@ void tx_poll_init(tx_poll_t *poll,
 	tx_task_t *task;
 	task = &poll->tx_task;
 	tx_task_init(task, loop, call, data);
+	memset(&poll->tx_stat, 0, sizeof(poll->tx_stat));
+	poll->tx_mark = 0;
+	return;
+}
+
+void tx_poll_waitstart(tx_poll_t *poll)
+{
+	unsigned long long now = tx_getusecs();
+
+	if (poll->tx_mark != 0)
+		poll->tx_stat.ps_dispatch_us += (now - poll->tx_mark);
+
+	poll->tx_mark = now;
+	return;
+}
+
+void tx_poll_waitdone(tx_poll_t *poll, int nevent)
+{
+	unsigned long long now = tx_getusecs();
+	tx_poll_stat *stat = &poll->tx_stat;
+
+	stat->ps_blocked_us += (now - poll->tx_mark);
+	poll->tx_mark = now;
+
+	stat->ps_waits++;
+	if (nevent < 0) {
+		stat->ps_failures++;
+		return;
+	}
+
+	stat->ps_empty_waits += (nevent == 0);
+	stat->ps_nevents += nevent;
+	stat->ps_events[tx_log2_slot(nevent, POLL_HIST_SLOTS)]++;
+	return;
+}
+
+const tx_poll_stat *tx_poll_getstat(tx_poll_t *poll)
+{
+	return &poll->tx_stat;
+}
+
+void tx_poll_resetstat(tx_poll_t *poll)
+{
+	memset(&poll->tx_stat, 0, sizeof(poll->tx_stat));
+	poll->tx_mark = 0;
 	return;
 }
 
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#if defined(WIN32)
+#include <winsock2.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "txall.h"
+
+#define RELAY_CHUNK (64 * 1024)
+
+/*
+ * the pipe (or the copy buffer) is always drained before src is read
+ * again, so EAGAIN from the read side always mean src is not readable,
+ * never that the pipe is full.
+ */
+static void tx_relay_pump(void *up);
+
+void tx_relay_init(tx_relay *relay, tx_aiocb *src, tx_aiocb *dst)
+{
+	tx_loop_t *loop = tx_loop_get(&src->tx_poll->tx_task);
+
+	relay->rl_flags = 0;
+	relay->rl_error = 0;
+	relay->rl_pipe[0] = relay->rl_pipe[1] = -1;
+	relay->rl_inpipe = 0;
+	relay->rl_total = 0;
+	relay->rl_src = src;
+	relay->rl_dst = dst;
+	relay->rl_buf = NULL;
+	relay->rl_off = relay->rl_len = 0;
+	relay->rl_done = NULL;
+	tx_task_init(&relay->rl_task, loop, tx_relay_pump, relay);
+
+#ifdef __linux__
+	/* the io_uring poller queue its own sends, splice would pass them */
+	if (dst->tx_poll->tx_ops->tx_sendout == NULL &&
+			pipe2(relay->rl_pipe, O_NONBLOCK| O_CLOEXEC) == 0) {
+		relay->rl_flags |= TX_RELAY_SPLICE;
+	}
+#endif
+
+	return;
+}
+
+void tx_relay_fini(tx_relay *relay)
+{
+	tx_aincb_stop(relay->rl_src, &relay->rl_task);
+	tx_outcb_cancel(relay->rl_dst, &relay->rl_task);
+	tx_task_drop(&relay->rl_task);
+
+	if (relay->rl_pipe[0] != -1) {
+		close(relay->rl_pipe[0]);
+		close(relay->rl_pipe[1]);
+		relay->rl_pipe[0] = relay->rl_pipe[1] = -1;
+	}
+
+	if (relay->rl_buf != NULL) {
+		tx_membuf_drop(relay->rl_buf);
+		relay->rl_buf = NULL;
+	}
+
+	relay->rl_done = NULL;
+	return;
+}
+
+static int tx_relay_copy(tx_relay *relay)
+{
+	int n;
+	char *buf;
+	tx_aiocb *src = relay->rl_src;
+	tx_aiocb *dst = relay->rl_dst;
+
+	if (relay->rl_buf == NULL) {
+		relay->rl_buf = tx_membuf_alloc(tx_loop_get(&relay->rl_task), RELAY_CHUNK);
+		if (relay->rl_buf == NULL) {
+			relay->rl_error = ENOMEM;
+			return 0;
+		}
+	}
+
+	buf = (char *)relay->rl_buf->iob_alloc;
+	for ( ; ; ) {
+		if (relay->rl_off < relay->rl_len) {
+			if (!tx_writable(dst)) {
+				tx_outcb_prepare(dst, &relay->rl_task, 0);
+				return 1;
+			}
+
+			n = tx_outcb_write(dst, buf + relay->rl_off, relay->rl_len - relay->rl_off);
+			if (n > 0) {
+				relay->rl_off += n;
+				relay->rl_total += n;
+				continue;
+			}
+
+			if (n < 0 && !tx_writable(dst)) {
+				continue;
+			}
+
+			relay->rl_error = (n < 0? errno: EPIPE);
+			return 0;
+		}
+
+		if (relay->rl_flags & TX_RELAY_EOF) {
+			if (!tx_writable(dst)) {
+				/* the last write is still being sent, shut down after it */
+				tx_outcb_prepare(dst, &relay->rl_task, 0);
+				return 1;
+			}
+
+			return 0;
+		}
+
+		if (!tx_readable(src)) {
+			tx_aincb_active(src, &relay->rl_task);
+			return 1;
+		}
+
+#ifndef WIN32
+		n = read(src->tx_fd, buf, RELAY_CHUNK);
+#else
+		n = recv(src->tx_fd, buf, RELAY_CHUNK, 0);
+#endif
+		tx_aincb_update(src, n);
+		if (n > 0) {
+			relay->rl_off = 0;
+			relay->rl_len = n;
+			continue;
+		}
+
+		if (n == 0) {
+			relay->rl_flags |= TX_RELAY_EOF;
+			continue;
+		}
+
+		if (!tx_readable(src) || errno == EINTR) {
+			continue;
+		}
+
+		relay->rl_error = errno;
+		return 0;
+	}
+
+	return 0;
+}
+
+#ifdef __linux__
+static int tx_relay_splice(tx_relay *relay)
+{
+	ssize_t n;
+	tx_aiocb *src = relay->rl_src;
+	tx_aiocb *dst = relay->rl_dst;
+
+	for ( ; ; ) {
+		if (relay->rl_inpipe > 0) {
+			if (!tx_writable(dst)) {
+				tx_outcb_prepare(dst, &relay->rl_task, 0);
+				return 1;
+			}
+
+			n = splice(relay->rl_pipe[0], NULL, dst->tx_fd, NULL,
+					relay->rl_inpipe, SPLICE_F_MOVE| SPLICE_F_NONBLOCK);
+			tx_outcb_update(dst, n);
+			if (n > 0) {
+				relay->rl_inpipe -= n;
+				relay->rl_total += n;
+				continue;
+			}
+
+			if (n < 0 && (!tx_writable(dst) || errno == EINTR)) {
+				continue;
+			}
+
+			relay->rl_error = (n < 0? errno: EPIPE);
+			return 0;
+		}
+
+		if (relay->rl_flags & TX_RELAY_EOF) {
+			return 0;
+		}
+
+		if (!tx_readable(src)) {
+			tx_aincb_active(src, &relay->rl_task);
+			return 1;
+		}
+
+		n = splice(src->tx_fd, NULL, relay->rl_pipe[1], NULL,
+				RELAY_CHUNK, SPLICE_F_MOVE| SPLICE_F_NONBLOCK);
+		tx_aincb_update(src, n);
+		if (n > 0) {
+			relay->rl_inpipe = n;
+			continue;
+		}
+
+		if (n == 0) {
+			relay->rl_flags |= TX_RELAY_EOF;
+			continue;
+		}
+
+		if (!tx_readable(src) || errno == EINTR) {
+			continue;
+		}
+
+		if (errno == EINVAL && relay->rl_total == 0) {
+			/* fd type splice can not handle, copy instead */
+			relay->rl_flags &= ~TX_RELAY_SPLICE;
+			return tx_relay_copy(relay);
+		}
+
+		relay->rl_error = errno;
+		return 0;
+	}
+
+	return 0;
+}
+#endif
+
+static void tx_relay_pump(void *up)
+{
+	int pending;
+	tx_task_t *done;
+	tx_relay *relay = (tx_relay *)up;
+
+#ifdef __linux__
+	if (relay->rl_flags & TX_RELAY_SPLICE)
+		pending = tx_relay_splice(relay);
+	else
+#endif
+		pending = tx_relay_copy(relay);
+
+	if (pending) {
+		return;
+	}
+
+	if (relay->rl_error == 0) {
+		/* propagate eof, the other direction may still be running */
+		shutdown(relay->rl_dst->tx_fd, SHUT_WR);
+	}
+
+	relay->rl_flags |= TX_RELAY_DONE;
+	done = relay->rl_done;
+	relay->rl_done = NULL;
+	tx_task_active(done, relay);
+	return;
+}
+
+void tx_relay_start(tx_relay *relay, tx_task_t *done)
+{
+	relay->rl_done = done;
+	tx_task_active(&relay->rl_task, relay);
+	return;
+}
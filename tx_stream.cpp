@@ -0,0 +1,437 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WIN32)
+#include <winsock2.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#include "txall.h"
+
+#define STREAM_INSIZE  4096
+#define STREAM_INLIMIT (1 << 20)
+#define STREAM_OUTSIZE 4096
+
+/*
+ * st_inhead/st_intail are free running offsets, the ring size is a power
+ * of two. st_scanned is how far after st_inhead the delimiter was already
+ * searched, so a line arriving in small pieces is scanned only once.
+ */
+static void tx_stream_inpump(void *up);
+static void tx_stream_outpump(void *up);
+
+void tx_stream_init(tx_stream *stream, tx_aiocb *filp, size_t insize, size_t inlimit)
+{
+	size_t size = STREAM_INSIZE;
+	tx_loop_t *loop = tx_loop_get(&filp->tx_poll->tx_task);
+
+	while (size < insize) size *= 2;
+
+	stream->st_flags = 0;
+	stream->st_error = 0;
+	stream->st_file = filp;
+
+	stream->st_inbuf = NULL;
+	stream->st_insize = size;
+	stream->st_inlimit = max(inlimit? inlimit: STREAM_INLIMIT, size);
+	stream->st_inhead = 0;
+	stream->st_intail = 0;
+	stream->st_scanned = 0;
+
+	stream->st_delim = -1;
+	stream->st_want = 0;
+	stream->st_reader = NULL;
+	tx_task_init(&stream->st_inpump, loop, tx_stream_inpump, stream);
+
+	stream->st_outbuf = NULL;
+	stream->st_outsize = 0;
+	stream->st_outhead = 0;
+	stream->st_outtail = 0;
+	stream->st_writer = NULL;
+	tx_task_init(&stream->st_outpump, loop, tx_stream_outpump, stream);
+	return;
+}
+
+void tx_stream_fini(tx_stream *stream)
+{
+	tx_aincb_stop(stream->st_file, &stream->st_inpump);
+	tx_outcb_cancel(stream->st_file, &stream->st_outpump);
+	tx_task_drop(&stream->st_inpump);
+	tx_task_drop(&stream->st_outpump);
+
+	free(stream->st_inbuf);
+	free(stream->st_outbuf);
+	stream->st_inbuf = NULL;
+	stream->st_outbuf = NULL;
+	stream->st_reader = NULL;
+	stream->st_writer = NULL;
+	return;
+}
+
+size_t tx_stream_buffered(tx_stream *stream)
+{
+	return stream->st_intail - stream->st_inhead;
+}
+
+/* copy the ring into a new one of size byte, the data start at offset 0 */
+static int tx_stream_reshape(tx_stream *stream, size_t size)
+{
+	char *buf;
+	size_t off, seg;
+	size_t count = tx_stream_buffered(stream);
+
+	buf = (char *)malloc(size);
+	TX_CHECK(buf != NULL, "alloc stream ring failure");
+	if (buf == NULL) {
+		return -1;
+	}
+
+	if (count > 0) {
+		off = stream->st_inhead & (stream->st_insize - 1);
+		seg = min(count, stream->st_insize - off);
+		memcpy(buf, stream->st_inbuf + off, seg);
+		memcpy(buf + seg, stream->st_inbuf, count - seg);
+	}
+
+	free(stream->st_inbuf);
+	stream->st_inbuf = buf;
+	stream->st_insize = size;
+	stream->st_inhead = 0;
+	stream->st_intail = count;
+	return 0;
+}
+
+char *tx_stream_peek(tx_stream *stream, size_t len)
+{
+	size_t off;
+
+	TX_ASSERT(len <= tx_stream_buffered(stream));
+	if (stream->st_inbuf == NULL) {
+		return NULL;
+	}
+
+	off = stream->st_inhead & (stream->st_insize - 1);
+	if (off + len > stream->st_insize &&
+			tx_stream_reshape(stream, stream->st_insize) != 0) {
+		return NULL;
+	}
+
+	return stream->st_inbuf + (stream->st_inhead & (stream->st_insize - 1));
+}
+
+void tx_stream_consume(tx_stream *stream, size_t len)
+{
+	TX_ASSERT(len <= tx_stream_buffered(stream));
+	stream->st_inhead += len;
+	stream->st_scanned = (stream->st_scanned > len? stream->st_scanned - len: 0);
+
+	if (stream->st_inhead == stream->st_intail) {
+		/* empty ring, restart at offset 0 so reads stay contiguous */
+		stream->st_inhead = stream->st_intail = 0;
+	}
+
+	return;
+}
+
+/* length of the pending read when it can complete, else 0 */
+static size_t tx_stream_ready(tx_stream *stream)
+{
+	char *p;
+	size_t off, seg;
+	size_t count = tx_stream_buffered(stream);
+
+	if (stream->st_delim == -1) {
+		return count >= stream->st_want? stream->st_want: 0;
+	}
+
+	while (stream->st_scanned < count) {
+		off = (stream->st_inhead + stream->st_scanned) & (stream->st_insize - 1);
+		seg = min(count - stream->st_scanned, stream->st_insize - off);
+
+		p = (char *)memchr(stream->st_inbuf + off, stream->st_delim, seg);
+		if (p != NULL) {
+			return stream->st_scanned + (p - (stream->st_inbuf + off)) + 1;
+		}
+
+		stream->st_scanned += seg;
+	}
+
+	return 0;
+}
+
+static int tx_stream_readin(tx_stream *stream)
+{
+	int n;
+	size_t off, room;
+	size_t mask = stream->st_insize - 1;
+
+	off  = stream->st_intail & mask;
+	room = stream->st_insize - tx_stream_buffered(stream);
+
+#ifndef WIN32
+	struct iovec vec[2];
+	vec[0].iov_base = stream->st_inbuf + off;
+	vec[0].iov_len  = min(room, stream->st_insize - off);
+	vec[1].iov_base = stream->st_inbuf;
+	vec[1].iov_len  = room - vec[0].iov_len;
+	n = readv(stream->st_file->tx_fd, vec, vec[1].iov_len > 0? 2: 1);
+#else
+	n = recv(stream->st_file->tx_fd, stream->st_inbuf + off, min(room, stream->st_insize - off), 0);
+#endif
+
+	tx_aincb_update(stream->st_file, n);
+	return n;
+}
+
+/*
+ * read until the pending read can complete: return its length, 0 when the
+ * fd run dry (the pump is armed), or -1 at eof, error or ENOBUFS.
+ */
+static int tx_stream_fill(tx_stream *stream)
+{
+	int n;
+	size_t ready, limit;
+
+	if (stream->st_inbuf == NULL &&
+			tx_stream_reshape(stream, stream->st_insize) != 0) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	limit = max(stream->st_inlimit, stream->st_want);
+	for ( ; ; ) {
+		ready = tx_stream_ready(stream);
+		if (ready > 0) {
+			return (int)ready;
+		}
+
+		if (stream->st_flags & (TX_STREAM_EOF| TX_STREAM_ERROR)) {
+			errno = stream->st_error;
+			return -1;
+		}
+
+		if (tx_stream_buffered(stream) == stream->st_insize) {
+			if (stream->st_insize >= limit) {
+				errno = ENOBUFS;
+				return -1;
+			}
+
+			if (tx_stream_reshape(stream, stream->st_insize * 2) != 0) {
+				errno = ENOMEM;
+				return -1;
+			}
+		}
+
+		if (!tx_readable(stream->st_file)) {
+			tx_aincb_active(stream->st_file, &stream->st_inpump);
+			return 0;
+		}
+
+		n = tx_stream_readin(stream);
+		if (n > 0) {
+			stream->st_intail += n;
+			continue;
+		}
+
+		if (n == 0) {
+			stream->st_flags |= TX_STREAM_EOF;
+			stream->st_error = 0;
+			continue;
+		}
+
+		if (tx_readable(stream->st_file) && errno != EINTR) {
+			stream->st_flags |= TX_STREAM_ERROR;
+			stream->st_error = errno;
+		}
+	}
+
+	return 0;
+}
+
+static int tx_stream_read(tx_stream *stream, int delim, size_t len, tx_task_t *task)
+{
+	int n;
+
+	if (stream->st_delim != delim || stream->st_want != len) {
+		stream->st_delim = delim;
+		stream->st_want = len;
+		stream->st_scanned = 0;
+	}
+
+	n = tx_stream_fill(stream);
+	stream->st_reader = (n == 0? task: NULL);
+	return n;
+}
+
+int tx_stream_readuntil(tx_stream *stream, int delim, tx_task_t *task)
+{
+	return tx_stream_read(stream, (unsigned char)delim, 0, task);
+}
+
+int tx_stream_readexact(tx_stream *stream, size_t len, tx_task_t *task)
+{
+	TX_ASSERT(len > 0);
+	return tx_stream_read(stream, -1, len, task);
+}
+
+static void tx_stream_inpump(void *up)
+{
+	tx_task_t *task;
+	tx_stream *stream = (tx_stream *)up;
+
+	if (stream->st_reader != NULL &&
+			tx_stream_fill(stream) != 0) {
+		task = stream->st_reader;
+		stream->st_reader = NULL;
+		tx_task_active(task, stream);
+	}
+
+	return;
+}
+
+size_t tx_stream_pending(tx_stream *stream)
+{
+	return stream->st_outtail - stream->st_outhead;
+}
+
+/*
+ * return 1 when the queue is drained, 0 when the fd is full or the poller
+ * still send what it took last, -1 on error
+ */
+static int tx_stream_drain(tx_stream *stream)
+{
+	int n;
+
+	while (stream->st_outhead < stream->st_outtail) {
+		if (!tx_writable(stream->st_file)) {
+			return 0;
+		}
+
+		n = tx_outcb_write(stream->st_file,
+				stream->st_outbuf + stream->st_outhead, tx_stream_pending(stream));
+		if (n > 0) {
+			stream->st_outhead += n;
+			continue;
+		}
+
+		if (n < 0 && !tx_writable(stream->st_file)) {
+			return 0;
+		}
+
+		stream->st_flags |= TX_STREAM_ERROR;
+		stream->st_error = (n < 0? errno: EPIPE);
+		return -1;
+	}
+
+	stream->st_outhead = stream->st_outtail = 0;
+	return tx_writable(stream->st_file)? 1: 0;
+}
+
+static int tx_stream_queue(tx_stream *stream, const char *data, size_t len)
+{
+	char *buf;
+	size_t size;
+	size_t pending = tx_stream_pending(stream);
+
+	if (stream->st_outsize - stream->st_outtail < len && stream->st_outhead > 0) {
+		memmove(stream->st_outbuf, stream->st_outbuf + stream->st_outhead, pending);
+		stream->st_outhead = 0;
+		stream->st_outtail = pending;
+	}
+
+	if (stream->st_outsize - stream->st_outtail < len) {
+		size = max(stream->st_outsize, STREAM_OUTSIZE);
+		while (size < pending + len) size *= 2;
+
+		buf = (char *)realloc(stream->st_outbuf, size);
+		TX_CHECK(buf != NULL, "grow stream output failure");
+		if (buf == NULL) {
+			return -1;
+		}
+
+		stream->st_outbuf = buf;
+		stream->st_outsize = size;
+	}
+
+	memcpy(stream->st_outbuf + stream->st_outtail, data, len);
+	stream->st_outtail += len;
+	return 0;
+}
+
+int tx_stream_flush(tx_stream *stream, tx_task_t *task)
+{
+	int error;
+
+	error = tx_stream_drain(stream);
+	if (error == 0) {
+		stream->st_writer = task;
+		tx_outcb_prepare(stream->st_file, &stream->st_outpump, 0);
+	}
+
+	return error;
+}
+
+int tx_stream_writeall(tx_stream *stream, const void *data, size_t len, tx_task_t *task)
+{
+	int n;
+	int error;
+	size_t total = len;
+	const char *p = (const char *)data;
+
+	if (stream->st_flags & TX_STREAM_ERROR) {
+		errno = stream->st_error;
+		return -1;
+	}
+
+	/* nothing queued ahead: write straight from the caller buffer */
+	while (tx_stream_pending(stream) == 0 &&
+			len > 0 && tx_writable(stream->st_file)) {
+		n = tx_outcb_write(stream->st_file, p, len);
+		if (n > 0) {
+			p += n;
+			len -= n;
+			continue;
+		}
+
+		if (n < 0 && !tx_writable(stream->st_file)) {
+			break;
+		}
+
+		stream->st_flags |= TX_STREAM_ERROR;
+		stream->st_error = (n < 0? errno: EPIPE);
+		return -1;
+	}
+
+	if (len > 0 && tx_stream_queue(stream, p, len) != 0) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	error = tx_stream_flush(stream, task);
+	return error > 0? (int)total: error;
+}
+
+static void tx_stream_outpump(void *up)
+{
+	int error;
+	tx_task_t *task;
+	tx_stream *stream = (tx_stream *)up;
+
+	error = tx_stream_drain(stream);
+	if (error == 0) {
+		tx_outcb_prepare(stream->st_file, &stream->st_outpump, 0);
+		return;
+	}
+
+	task = stream->st_writer;
+	stream->st_writer = NULL;
+	if (task != NULL) {
+		tx_task_active(task, stream);
+	}
+
+	return;
+}
@@ -9,11 +9,26 @@
 
 #define MIN_MA_TIMER (MIN_TIME_OUT * MAX_MI_WHEEL)
 #define MIN_ST_TIMER (MIN_MA_TIMER * MAX_MA_WHEEL)
+#define RATE_TIMER 1000
+
+/* wheel level the timer is linked on, plus one, zero for unlinked */
+#define TIMER_LEVEL_SHIFT 4
+#define TIMER_LEVEL_MASK  0x70
+#define TIMER_LEVEL_GET(f) ((((f) & TIMER_LEVEL_MASK) >> TIMER_LEVEL_SHIFT) - 1)
+#define TIMER_LEVEL_SET(l) (((l) + 1) << TIMER_LEVEL_SHIFT)
+
+/* catch up timer still firing missed ticks, they are already counted */
+#define TIMER_BEHIND 0x80
 
 typedef struct tx_timer_ring {
 	size_t tx_st_tick;
 	tx_poll_t tx_tm_callout;
 	tx_timer_q tx_st_timers;
+	tx_timer_q tx_fire_timers;
+
+	size_t tx_rate_tick;
+	unsigned long tx_rate_mark;
+	tx_timer_stat tx_stat;
 
 	size_t tx_mi_tick;
 	size_t tx_mi_wheel;
@@ -27,12 +42,27 @@ typedef struct tx_timer_ring {
 void tx_timer_init(tx_timer_t *timer, tx_timer_ring *provider, tx_task_t *task)
 {
 	timer->interval = 0;
+	timer->tx_period = 0;
+	timer->tx_overrun = 0;
 	timer->tx_task  = task;
+	timer->tx_data  = NULL;
 	timer->tx_flags = TIMER_IDLE;
 	timer->tx_ring  = provider;
 	return;
 }
 
+void tx_timer_init(tx_timer_t *timer, tx_timer_ring *provider, void (*call)(void *), void *data)
+{
+	timer->interval = 0;
+	timer->tx_period = 0;
+	timer->tx_overrun = 0;
+	timer->tx_call  = call;
+	timer->tx_data  = data;
+	timer->tx_flags = TIMER_IDLE| TIMER_CALLOUT;
+	timer->tx_ring  = provider;
+	return;
+}
+
 void tx_timer_init(tx_timer_t *timer, tx_loop_t *loop, tx_task_t *task)
 {
 	tx_timer_ring *r = tx_timer_ring_get(loop);
@@ -40,40 +70,170 @@ void tx_timer_init(tx_timer_t *timer, tx_loop_t *loop, tx_task_t *task)
 	return;
 }
 
-void tx_timer_reset(tx_timer_t *timer, unsigned int umilsec)
+void tx_timer_init(tx_timer_t *timer, tx_loop_t *loop, void (*call)(void *), void *data)
+{
+	tx_timer_ring *r = tx_timer_ring_get(loop);
+	tx_timer_init(timer, r, call, data);
+	return;
+}
+
+static void tx_timer_insert(tx_timer_ring *ring, tx_timer_q *timerq, tx_timer_t *timer, int level)
+{
+	LIST_INSERT_HEAD(timerq, timer, entries);
+	timer->tx_flags |= TIMER_LEVEL_SET(level);
+	ring->tx_stat.ts_timers[level]++;
+	return;
+}
+
+static void tx_timer_unlink(tx_timer_ring *ring, tx_timer_t *timer)
+{
+	LIST_REMOVE(timer, entries);
+	ring->tx_stat.ts_timers[TIMER_LEVEL_GET(timer->tx_flags)]--;
+	timer->tx_flags &= ~TIMER_LEVEL_MASK;
+	return;
+}
+
+/* link the timer to fire at due, which is timer->interval unless catching up */
+static void tx_timer_place(tx_timer_ring *ring, tx_timer_t *timer, unsigned due)
 {
+	int delta;
 	size_t wheel;
 	size_t mi_wheel, ma_wheel;
+
+	timer->tx_flags &= ~TIMER_IDLE;
+	delta = (int)(due - ring->tx_mi_tick);
+	mi_wheel = (delta < MIN_TIME_OUT? 1: delta / MIN_TIME_OUT);
+
+	if (mi_wheel < MAX_MI_WHEEL) {
+		wheel = (ring->tx_mi_wheel + mi_wheel) % MAX_MI_WHEEL;
+		tx_timer_insert(ring, &ring->tx_mi_timers[wheel], timer, TIMER_LEVEL_MI);
+		return;
+	}
+
+	ma_wheel = (due - ring->tx_ma_tick) / MIN_MA_TIMER;
+	if (ma_wheel < MAX_MA_WHEEL) {
+		wheel = (ring->tx_ma_wheel + ma_wheel) % MAX_MA_WHEEL;
+		tx_timer_insert(ring, &ring->tx_ma_timers[wheel], timer, TIMER_LEVEL_MA);
+		return;
+	}
+
+	tx_timer_insert(ring, &ring->tx_st_timers, timer, TIMER_LEVEL_ST);
+	return;
+}
+
+static void tx_timer_link(tx_timer_ring *ring, tx_timer_t *timer)
+{
+	tx_timer_place(ring, timer, timer->interval);
+	return;
+}
+
+void tx_timer_reset(tx_timer_t *timer, unsigned int umilsec)
+{
 	tx_timer_ring *ring = timer->tx_ring;
 
-	if (timer->tx_flags & TIMER_IDLE) {
-		timer->tx_flags &= ~TIMER_IDLE;
-		timer->interval = (tx_ticks + umilsec);
-		mi_wheel = (timer->interval - ring->tx_mi_tick) / MIN_TIME_OUT;
+	if ((timer->tx_flags & TIMER_IDLE) == 0) {
+		tx_timer_unlink(timer->tx_ring, timer);
+		timer->tx_flags |= TIMER_IDLE;
+	}
 
-		TX_CHECK(mi_wheel > 0, "timer is too small");
-		mi_wheel = (mi_wheel == 0? 1: mi_wheel);
+	timer->tx_flags &= ~(TIMER_PERIODIC| TIMER_CATCHUP| TIMER_BEHIND);
+	timer->interval = (tx_ticks + umilsec);
+	ring->tx_stat.ts_resets++;
+	TX_CHECK((int)(timer->interval - ring->tx_mi_tick) >= MIN_TIME_OUT, "timer is too small");
 
-		if (mi_wheel < MAX_MI_WHEEL) {
-			wheel = (ring->tx_mi_wheel + mi_wheel) % MAX_MI_WHEEL;
-			LIST_INSERT_HEAD(&ring->tx_mi_timers[wheel], timer, entries);
-			return;
+	tx_timer_link(ring, timer);
+	return;
+}
+
+void tx_timer_period(tx_timer_t *timer, unsigned int umilsec, int policy)
+{
+	tx_timer_ring *ring = timer->tx_ring;
+
+	if ((timer->tx_flags & TIMER_IDLE) == 0) {
+		tx_timer_unlink(timer->tx_ring, timer);
+		timer->tx_flags |= TIMER_IDLE;
+	}
+
+	TX_CHECK(umilsec >= MIN_TIME_OUT, "period is too small");
+	umilsec = (umilsec < MIN_TIME_OUT? MIN_TIME_OUT: umilsec);
+
+	timer->tx_flags &= ~(TIMER_CATCHUP| TIMER_BEHIND);
+	timer->tx_flags |= (policy & TIMER_CATCHUP);
+	timer->tx_flags |= TIMER_PERIODIC;
+	timer->tx_period = umilsec;
+	timer->tx_overrun = 0;
+	timer->interval = (tx_ticks + umilsec);
+	ring->tx_stat.ts_resets++;
+
+	tx_timer_link(ring, timer);
+	return;
+}
+
+/* called with the timer unlinked, relink periodic timer before callback */
+static void tx_timer_rearm(tx_timer_t *timer, unsigned ticks)
+{
+	int late;
+	unsigned missed;
+	tx_timer_stat *stat = &timer->tx_ring->tx_stat;
+
+	late = (int)(ticks - timer->interval);
+	late = (late < 0? 0: late);
+	stat->ts_expires++;
+	stat->ts_late[tx_log2_slot(late, TIMER_HIST_SLOTS)]++;
+	stat->ts_late_max = max(stat->ts_late_max, (unsigned)late);
+
+	timer->tx_flags |= TIMER_IDLE;
+	if (timer->tx_flags & TIMER_PERIODIC) {
+		timer->interval += timer->tx_period;
+
+		if (late >= (int)timer->tx_period && (timer->tx_flags & TIMER_BEHIND) == 0) {
+			/* count the missed ticks once, when the stall is first seen */
+			missed = late / timer->tx_period;
+			timer->tx_overrun += missed;
+			if ((timer->tx_flags & TIMER_CATCHUP) == 0)
+				timer->interval += missed * timer->tx_period;
+			else
+				timer->tx_flags |= TIMER_BEHIND;
 		}
 
-		ma_wheel = (timer->interval - ring->tx_ma_tick) / MIN_MA_TIMER;
-		if (ma_wheel < MAX_MA_WHEEL) {
-			wheel = (ring->tx_ma_wheel + ma_wheel) % MAX_MA_WHEEL;
-			LIST_INSERT_HEAD(&ring->tx_ma_timers[wheel], timer, entries);
-			return;
+		if ((int)(ticks - timer->interval) < 0) {
+			timer->tx_flags &= ~TIMER_BEHIND;
+			tx_timer_link(timer->tx_ring, timer);
+		} else {
+			/* missed tick, fire it on the wheel slot after now, not in this pass */
+			tx_timer_place(timer->tx_ring, timer, ticks + MIN_TIME_OUT);
 		}
+	}
 
-		LIST_INSERT_HEAD(&ring->tx_st_timers, timer, entries);
+	return;
+}
+
+static void tx_timer_expire(tx_timer_t *timer, unsigned ticks)
+{
+	tx_timer_ring *ring = timer->tx_ring;
+
+	if (timer->tx_flags & TIMER_CALLOUT) {
+		/* keep it linked, so tx_timer_stop can still cancel it */
+		tx_timer_insert(ring, &ring->tx_fire_timers, timer, TIMER_LEVEL_FIRE);
 		return;
 	}
 
-	LIST_REMOVE(timer, entries);
-	timer->tx_flags |= TIMER_IDLE;
-	tx_timer_reset(timer, umilsec);
+	tx_timer_rearm(timer, ticks);
+	tx_task_active(timer->tx_task, timer);
+	return;
+}
+
+static void tx_timer_dispatch(tx_timer_ring *ring, unsigned ticks)
+{
+	tx_timer_t *cur;
+
+	while (!LIST_EMPTY(&ring->tx_fire_timers)) {
+		cur = LIST_FIRST(&ring->tx_fire_timers);
+		tx_timer_unlink(ring, cur);
+		tx_timer_rearm(cur, ticks);
+		cur->tx_call(cur->tx_data);
+	}
+
 	return;
 }
 
@@ -82,9 +242,8 @@ void tx_timer_drain(tx_timer_t *timer)
 	int check_flags = (timer->tx_flags & TIMER_IDLE);
 
 	if (check_flags == 0) {
-		LIST_REMOVE(timer, entries);
-		timer->tx_flags |= TIMER_IDLE;
-		tx_task_active(timer->tx_task, timer);
+		tx_timer_unlink(timer->tx_ring, timer);
+		tx_timer_expire(timer, tx_ticks);
 	}
 
 	return;
@@ -96,7 +255,7 @@ void tx_timer_stop(tx_timer_t *timer)
 
 	if (check_flags == 0) {
 		timer->tx_flags |= TIMER_IDLE;
-		LIST_REMOVE(timer, entries);
+		tx_timer_unlink(timer->tx_ring, timer);
 	}
 
 	return;
@@ -111,9 +270,12 @@ static void tx_timer_polling(void *up)
 	ring = (tx_callout_t *)up;
 
 	unsigned wheel;
+	unsigned steps = 0;
 	unsigned ticks = tx_getticks();
+	tx_timer_stat *stat = &ring->tx_stat;
 
 	while ((int)(ticks - ring->tx_mi_tick - MIN_TIME_OUT) >= 0) {
+		steps++;
 		ring->tx_mi_tick += MIN_TIME_OUT;
 		ring->tx_mi_wheel++;
 		wheel = (ring->tx_mi_wheel % MAX_MI_WHEEL);
@@ -121,13 +283,11 @@ static void tx_timer_polling(void *up)
 		timerq = ring->tx_mi_timers[wheel];
 		LIST_INIT(&ring->tx_mi_timers[wheel]);
 		LIST_FOREACH_SAFE(cur, &timerq, entries, next) {
-			LIST_REMOVE(cur, entries);
+			tx_timer_unlink(ring, cur);
 			if ((int)(cur->interval - ticks - MIN_TIME_OUT) < 0) {
-				cur->tx_flags |= TIMER_IDLE;
-				tx_task_active(cur->tx_task, cur);
+				tx_timer_expire(cur, ticks);
 			} else {
-				cur->tx_flags |= TIMER_IDLE;
-				tx_timer_reset(cur, cur->interval - ticks);
+				tx_timer_link(ring, cur);
 			}
 		}
 	}
@@ -140,13 +300,11 @@ static void tx_timer_polling(void *up)
 		timerq = ring->tx_ma_timers[wheel];
 		LIST_INIT(&ring->tx_ma_timers[wheel]);
 		LIST_FOREACH_SAFE(cur, &timerq, entries, next) {
-			LIST_REMOVE(cur, entries);
+			tx_timer_unlink(ring, cur);
 			if ((int)(cur->interval - ticks - MIN_TIME_OUT) < 0) {
-				cur->tx_flags |= TIMER_IDLE;
-				tx_task_active(cur->tx_task, cur);
+				tx_timer_expire(cur, ticks);
 			} else {
-				cur->tx_flags |= TIMER_IDLE;
-				tx_timer_reset(cur, cur->interval - ticks);
+				tx_timer_link(ring, cur);
 			}
 		}
 	}
@@ -157,17 +315,29 @@ static void tx_timer_polling(void *up)
 		timerq = ring->tx_st_timers;
 		LIST_INIT(&ring->tx_st_timers);
 		LIST_FOREACH_SAFE(cur, &timerq, entries, next) {
-			LIST_REMOVE(cur, entries);
+			tx_timer_unlink(ring, cur);
 			if ((int)(cur->interval - ticks - MIN_TIME_OUT) < 0) {
-				cur->tx_flags |= TIMER_IDLE;
-				tx_task_active(cur->tx_task, cur);
+				tx_timer_expire(cur, ticks);
 			} else {
-				cur->tx_flags |= TIMER_IDLE;
-				tx_timer_reset(cur, cur->interval - ticks);
+				tx_timer_link(ring, cur);
 			}
 		}
 	}
 
+	tx_timer_dispatch(ring, ticks);
+
+	if (steps > 0) {
+		stat->ts_steps[tx_log2_slot(steps, TIMER_HIST_SLOTS)]++;
+		stat->ts_steps_max = max(stat->ts_steps_max, steps);
+		stat->ts_catchups += (steps - 1);
+	}
+
+	if ((int)(ticks - ring->tx_rate_tick - RATE_TIMER) >= 0) {
+		stat->ts_reset_rate = (stat->ts_resets - ring->tx_rate_mark) * RATE_TIMER / (ticks - ring->tx_rate_tick);
+		ring->tx_rate_mark = stat->ts_resets;
+		ring->tx_rate_tick = ticks;
+	}
+
 	tx_poll_t *poll = &ring->tx_tm_callout;
 	if (tx_loop_timeout(poll->tx_task.tx_loop, ring)) {
 		usleep(10000);
@@ -189,7 +359,10 @@ static struct tx_timer_ring* tx_timer_ring_new(tx_loop_t *loop)
 	TX_CHECK(ring != NULL, "allocate memory failure");
 
 	ring->tx_st_tick = tx_getticks();
+	ring->tx_rate_tick = ring->tx_st_tick;
+	ring->tx_rate_mark = 0;
 	LIST_INIT(&ring->tx_st_timers);
+	LIST_INIT(&ring->tx_fire_timers);
 
 	ring->tx_mi_tick = tx_ticks;
 	ring->tx_mi_wheel = 0;
@@ -213,6 +386,11 @@ static struct tx_timer_ring* tx_timer_ring_new(tx_loop_t *loop)
 	return ring;
 }
 
+const tx_timer_stat *tx_timer_ring_stat(tx_timer_ring *ring)
+{
+	return &ring->tx_stat;
+}
+
 struct tx_timer_ring* tx_timer_ring_get(tx_loop_t *loop)
 {
 	tx_task_t *np;
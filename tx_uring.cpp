@@ -0,0 +1,1388 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "txall.h"
+
+#define URING_ENTRIES 256
+#define URING_BUFCOUNT 256
+#define URING_BUFSIZE  4096
+#define URING_QUEUE_HIGH 64
+#define URING_FILES    1024
+#define URING_FIXCOUNT 64
+#define URING_FIXSIZE  8192
+#define URING_SENDIOV  16
+#define URING_SENDMAX  (256 * 1024)
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#define URING_POLLIN  0x1
+#define URING_POLLOUT 0x2
+#define URING_SEND    0x3
+#define URING_ACCEPT  0x4
+#define URING_CONNECT 0x5
+#define URING_RECV    0x6
+#define URING_READ    0x7
+
+#define TX_MSHOTRECV  (TX_POLLER_PRIVATE << 0)
+#define TX_CANCELIN   (TX_POLLER_PRIVATE << 1)
+#define TX_BUFWAIT    (TX_POLLER_PRIVATE << 2)
+
+#define URING_BGID    0
+
+#define URING_NOMSHOT 0x1
+#define URING_MSHOTOK 0x2
+
+struct tx_uring_req_t;
+
+struct tx_uring_op_t {
+	int tx_op;
+	tx_uring_req_t *tx_req;
+};
+
+struct tx_uring_t;
+
+struct tx_uring_buf_t {
+	tx_membuf ub_mem;
+	unsigned ub_bid;
+	tx_uring_t *ub_uring;
+};
+
+struct tx_uring_ent_t {
+	int tx_res;
+	tx_aiobuf tx_buf;
+};
+
+/*
+ * per aiocb request state, refcounted like tx_overlapped_t in the
+ * completion port backend: the aiocb hold one reference and every
+ * submitted sqe hold one, so completions arriving after detach are safe.
+ *
+ * accept and recv completions are queued in tx_queue until the aiocb
+ * owner pick them up, tx_res is the accepted fd or the received length,
+ * or -errno, a received buffer hold one reference of its tx_membuf.
+ *
+ * a send go from tx_sendbuf, or from the tx_sendnbuf buffers of
+ * tx_sendbufs with SENDMSG, tx_sendoff of tx_sendlen byte are done.
+ * the caller was already told those byte are written, so a failed send
+ * is kept in tx_senderr and returned by every later send.
+ *
+ * a recv that found no buffer is parked on uring_parked (TX_BUFWAIT) and
+ * rearmed when a buffer is given back, instead of spinning on ENOBUFS.
+ */
+struct tx_uring_req_t {
+	int tx_refcnt;
+	int tx_slot;
+	int tx_qhead;
+	int tx_qtail;
+	int tx_qsize;
+	tx_uring_ent_t *tx_queue;
+	int tx_sendoff;
+	int tx_sendlen;
+	int tx_sendnbuf;
+	int tx_senderr;
+	const char *tx_sendbuf;
+	tx_uring_buf_t *tx_sendfix;
+	tx_aiobuf tx_sendbufs[URING_SENDIOV];
+	struct iovec tx_sendiov[URING_SENDIOV];
+	struct msghdr tx_sendmsg;
+	tx_uring_buf_t *tx_recvfix;
+	tx_aiocb *tx_filp;
+	char tx_cache[8192];
+	struct sockaddr_storage tx_addr;
+	LIST_ENTRY(tx_uring_req_t) entries;
+	TAILQ_ENTRY(tx_uring_req_t) tx_parked;
+	tx_uring_op_t tx_send, tx_recv;
+};
+
+LIST_HEAD(tx_uring_req_l, tx_uring_req_t);
+TAILQ_HEAD(tx_uring_req_q, tx_uring_req_t);
+
+/*
+ * sqes are only queued while the loop run the tasks, tx_uring_polling
+ * submit them all and reap the completions with one io_uring_enter.
+ * uring_mode hold the TX_URING_* features really enabled.
+ */
+typedef struct tx_uring_t {
+	int uring_fd;
+	int uring_mode;
+	int uring_flags;
+	int uring_refcnt;
+	unsigned uring_features;
+	struct __kernel_timespec uring_ts;
+	tx_poll_t uring_poll;
+	tx_uring_req_l uring_list;
+	tx_uring_req_q uring_parked;
+
+	unsigned uring_bufcount;
+	unsigned uring_bufout;
+	unsigned uring_bufsize;
+	unsigned short uring_buftail;
+	char *uring_bufbase;
+	tx_uring_buf_t *uring_bufs;
+	struct io_uring_buf_ring *uring_bufring;
+
+	int *uring_slots;
+	unsigned uring_nslot;
+
+	tx_uring_buf_t *uring_fixed;
+	tx_uring_buf_t **uring_fixfree;
+	unsigned uring_nfixfree;
+
+	unsigned uring_sqlocal;
+	unsigned *uring_sqhead;
+	unsigned *uring_sqtail;
+	unsigned *uring_sqflags;
+	unsigned *uring_sqmask;
+	unsigned *uring_sqarray;
+	unsigned uring_sqentries;
+	struct io_uring_sqe *uring_sqes;
+
+	unsigned *uring_cqhead;
+	unsigned *uring_cqtail;
+	unsigned *uring_cqmask;
+	struct io_uring_cqe *uring_cqes;
+
+	void *uring_sqring;
+	size_t uring_sqsize;
+	void *uring_cqring;
+	size_t uring_cqsize;
+	size_t uring_sqessize;
+} tx_uring_t;
+
+static int tx_uring_sendout(tx_aiocb *filp, const void *buf, size_t len);
+static int tx_uring_sendoutv(tx_aiocb *filp, tx_aiobuf *bufs, size_t count);
+static int tx_uring_connect(tx_aiocb *filp, void *buf, size_t len);
+static int tx_uring_accept(tx_aiocb *filp, void *buf, size_t *len);
+static void tx_uring_pollout(tx_aiocb *filp);
+static void tx_uring_attach(tx_aiocb *filp);
+static void tx_uring_pollin(tx_aiocb *filp);
+static void tx_uring_park(tx_uring_t *uring, tx_uring_req_t *req);
+static void tx_uring_unpark(tx_uring_t *uring);
+static void tx_uring_detach(tx_aiocb *filp);
+
+static tx_poll_op _uring_ops = {
+	.tx_sendout = tx_uring_sendout,
+	.tx_sendoutv = tx_uring_sendoutv,
+	.tx_connect = tx_uring_connect,
+	.tx_accept = tx_uring_accept,
+	.tx_pollout = tx_uring_pollout,
+	.tx_attach = tx_uring_attach,
+	.tx_pollin = tx_uring_pollin,
+	.tx_detach = tx_uring_detach
+};
+
+static int tx_uring_submit(tx_uring_t *uring, unsigned wait, int timeout)
+{
+	unsigned flags = 0;
+	unsigned submit = 0;
+	struct __kernel_timespec ts = {0, 0};
+	struct io_uring_getevents_arg arg;
+
+	__atomic_store_n(uring->uring_sqtail, uring->uring_sqlocal, __ATOMIC_RELEASE);
+
+	if (uring->uring_mode & TX_URING_SQPOLL) {
+		/* the kernel thread pick up the sqes, enter only to wake it up or to wait */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (__atomic_load_n(uring->uring_sqflags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+	} else {
+		submit = uring->uring_sqlocal - __atomic_load_n(uring->uring_sqhead, __ATOMIC_ACQUIRE);
+	}
+
+	if (wait == 0 && submit == 0 && flags == 0) {
+		return 0;
+	}
+
+	if (wait > 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+	}
+
+	if (wait > 0 && (uring->uring_features & IORING_FEAT_EXT_ARG)) {
+		memset(&arg, 0, sizeof(arg));
+		ts.tv_nsec = timeout * 1000000LL;
+		arg.ts = (unsigned long)&ts;
+		flags |= IORING_ENTER_EXT_ARG;
+		return syscall(__NR_io_uring_enter, uring->uring_fd, submit, wait, flags, &arg, sizeof(arg));
+	}
+
+	return syscall(__NR_io_uring_enter, uring->uring_fd, submit, wait, flags, NULL, 0);
+}
+
+static struct io_uring_sqe *tx_uring_sqe(tx_uring_t *uring)
+{
+	int error;
+	unsigned head, tail, index;
+	struct io_uring_sqe *sqe;
+
+	tail = uring->uring_sqlocal;
+	head = __atomic_load_n(uring->uring_sqhead, __ATOMIC_ACQUIRE);
+
+	while (tail - head >= uring->uring_sqentries) {
+		/* submission queue is full, flush it early */
+		error = tx_uring_submit(uring, 0, 0);
+		TX_CHECK(error >= 0, "io_uring_enter submit failure");
+		if (uring->uring_mode & TX_URING_SQPOLL)
+			syscall(__NR_io_uring_enter, uring->uring_fd, 0, 0, IORING_ENTER_SQ_WAIT, NULL, 0);
+		head = __atomic_load_n(uring->uring_sqhead, __ATOMIC_ACQUIRE);
+	}
+
+	index = tail & *uring->uring_sqmask;
+	sqe = &uring->uring_sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+
+	uring->uring_sqarray[index] = index;
+	uring->uring_sqlocal = tail + 1;
+	return sqe;
+}
+
+/*
+ * publish the queued sqes and wait for the kernel to take them, so they
+ * have looked up their fd before the owner close it.
+ */
+static void tx_uring_flush(tx_uring_t *uring)
+{
+	int error;
+
+	error = tx_uring_submit(uring, 0, 0);
+	TX_CHECK(error >= 0, "io_uring_enter submit failure");
+
+	while ((uring->uring_mode & TX_URING_SQPOLL) &&
+			__atomic_load_n(uring->uring_sqhead, __ATOMIC_ACQUIRE) != uring->uring_sqlocal) {
+		if (__atomic_load_n(uring->uring_sqflags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+			syscall(__NR_io_uring_enter, uring->uring_fd, 0, 0, IORING_ENTER_SQ_WAKEUP, NULL, 0);
+		sched_yield();
+	}
+
+	return;
+}
+
+static struct io_uring_sqe *tx_uring_prep(tx_uring_t *uring, tx_uring_req_t *req, int opcode)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = tx_uring_sqe(uring);
+	sqe->opcode = opcode;
+
+	if (req->tx_slot >= 0) {
+		sqe->fd = req->tx_slot;
+		sqe->flags = IOSQE_FIXED_FILE;
+	} else {
+		sqe->fd = req->tx_filp->tx_fd;
+	}
+
+	return sqe;
+}
+
+static tx_uring_buf_t *tx_uring_fixget(tx_uring_t *uring)
+{
+	tx_uring_buf_t *ubp;
+
+	if (uring->uring_nfixfree == 0) {
+		return NULL;
+	}
+
+	ubp = uring->uring_fixfree[--uring->uring_nfixfree];
+	ubp->ub_mem.iob_use = 1;
+	return ubp;
+}
+
+static void tx_uring_fixput(tx_membuf *mbp)
+{
+	tx_uring_buf_t *ubp;
+
+	ubp = container_of(mbp, tx_uring_buf_t, ub_mem);
+	ubp->ub_uring->uring_fixfree[ubp->ub_uring->uring_nfixfree++] = ubp;
+	tx_uring_unpark(ubp->ub_uring);
+	return;
+}
+
+static int tx_uring_files_update(tx_uring_t *uring, int slot, int fd)
+{
+	struct io_uring_files_update update;
+
+	memset(&update, 0, sizeof(update));
+	update.offset = slot;
+	update.fds = (unsigned long)&fd;
+	return syscall(__NR_io_uring_register, uring->uring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1);
+}
+
+static void tx_uring_hold(tx_uring_t *uring, tx_uring_req_t *req)
+{
+	req->tx_refcnt++;
+	uring->uring_refcnt++;
+
+#ifndef DISABLE_MULTI_POLLER
+	tx_loop_t *loop = tx_loop_get(&uring->uring_poll.tx_task);
+	if (!loop->tx_holder)
+		loop->tx_holder = uring;
+#endif
+
+	return;
+}
+
+static void tx_uring_sendput(tx_uring_req_t *req)
+{
+	for (int i = 0; i < req->tx_sendnbuf; i++)
+		tx_aiobuf_drop(&req->tx_sendbufs[i]);
+
+	req->tx_sendnbuf = 0;
+	return;
+}
+
+static void tx_uring_send(tx_uring_t *uring, tx_uring_req_t *req)
+{
+	int i, n = 0;
+	size_t skip = req->tx_sendoff;
+	struct io_uring_sqe *sqe;
+
+	if (req->tx_sendnbuf > 0) {
+		/* skip what the previous part already sent */
+		for (i = 0; i < req->tx_sendnbuf; i++) {
+			tx_aiobuf *iobp = &req->tx_sendbufs[i];
+			if (skip >= iobp->iob_len) {
+				skip -= iobp->iob_len;
+				continue;
+			}
+
+			req->tx_sendiov[n].iov_base = iobp->iob_buf + skip;
+			req->tx_sendiov[n].iov_len  = iobp->iob_len - skip;
+			skip = 0;
+			n++;
+		}
+
+		memset(&req->tx_sendmsg, 0, sizeof(req->tx_sendmsg));
+		req->tx_sendmsg.msg_iov = req->tx_sendiov;
+		req->tx_sendmsg.msg_iovlen = n;
+
+		sqe = tx_uring_prep(uring, req, IORING_OP_SENDMSG);
+		sqe->msg_flags = MSG_NOSIGNAL;
+		sqe->addr = (unsigned long)&req->tx_sendmsg;
+		sqe->len = 1;
+	} else {
+		if (req->tx_sendfix != NULL) {
+			sqe = tx_uring_prep(uring, req, IORING_OP_WRITE_FIXED);
+			sqe->buf_index = req->tx_sendfix->ub_bid;
+			sqe->off = (unsigned long long)-1;
+		} else {
+			sqe = tx_uring_prep(uring, req, IORING_OP_SEND);
+			sqe->msg_flags = MSG_NOSIGNAL;
+		}
+
+		sqe->addr = (unsigned long)(req->tx_sendbuf + req->tx_sendoff);
+		sqe->len = req->tx_sendlen - req->tx_sendoff;
+	}
+
+	sqe->user_data = (unsigned long)&req->tx_send;
+
+	req->tx_send.tx_op = URING_SEND;
+	tx_uring_hold(uring, req);
+	return;
+}
+
+int tx_uring_sendout(tx_aiocb *filp, const void *buf, size_t len)
+{
+	int error, flags;
+	tx_uring_t *uring;
+	tx_uring_req_t *req;
+	uring = container_of(filp->tx_poll, tx_uring_t, uring_poll);
+	TX_ASSERT(filp->tx_poll->tx_ops == &_uring_ops);
+
+	if ((filp->tx_flags & TX_POLLOUT) == 0x0) {
+		flags = TX_ATTACHED | TX_DETACHED;
+		TX_ASSERT((filp->tx_flags & flags) == TX_ATTACHED);
+
+		req = (tx_uring_req_t *)filp->tx_privp;
+		if (req->tx_senderr != 0) {
+			errno = req->tx_senderr;
+			return -1;
+		}
+
+		len = min(len, INT_MAX);
+		error = send(filp->tx_fd, buf, len, MSG_DONTWAIT| MSG_NOSIGNAL);
+		if (error >= 0 || errno != EAGAIN) return error;
+
+		if (TX_MEMLOCK & filp->tx_flags) {
+			req->tx_sendbuf = (const char *)buf;
+		} else if (len <= URING_FIXSIZE &&
+				(req->tx_sendfix = tx_uring_fixget(uring)) != NULL) {
+			memcpy(req->tx_sendfix->ub_mem.iob_alloc, buf, len);
+			req->tx_sendbuf = (const char *)req->tx_sendfix->ub_mem.iob_alloc;
+		} else if (len <= sizeof(req->tx_cache)) {
+			memcpy(req->tx_cache, buf, len);
+			req->tx_sendbuf = req->tx_cache;
+		} else {
+			/* too large for the cache, send it from a pool buffer */
+			len = min(len, URING_SENDMAX);
+			if (tx_aiobuf_alloc(&req->tx_sendbufs[0],
+						tx_loop_get(&uring->uring_poll.tx_task), len) != 0) {
+				errno = ENOMEM;
+				return -1;
+			}
+
+			memcpy(req->tx_sendbufs[0].iob_buf, buf, len);
+			req->tx_sendnbuf = 1;
+		}
+
+		req->tx_sendoff = 0;
+		req->tx_sendlen = len;
+		tx_uring_send(uring, req);
+
+		filp->tx_flags &= ~TX_WRITABLE;
+		filp->tx_flags |= TX_POLLOUT;
+		return len;
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+/*
+ * vectored send: try sendmsg at once, on EAGAIN keep a reference of each
+ * buffer (a copy when it has no iob_base) and queue one SENDMSG for all.
+ */
+int tx_uring_sendoutv(tx_aiocb *filp, tx_aiobuf *bufs, size_t count)
+{
+	int i, error, flags;
+	size_t total = 0;
+	tx_uring_t *uring;
+	tx_uring_req_t *req;
+	struct msghdr msg;
+	struct iovec iov[URING_SENDIOV];
+	uring = container_of(filp->tx_poll, tx_uring_t, uring_poll);
+	TX_ASSERT(filp->tx_poll->tx_ops == &_uring_ops);
+
+	if ((filp->tx_flags & TX_POLLOUT) == 0x0) {
+		flags = TX_ATTACHED | TX_DETACHED;
+		TX_ASSERT((filp->tx_flags & flags) == TX_ATTACHED);
+
+		req = (tx_uring_req_t *)filp->tx_privp;
+		if (req->tx_senderr != 0) {
+			errno = req->tx_senderr;
+			return -1;
+		}
+
+		count = min(count, URING_SENDIOV);
+		for (i = 0; i < (int)count; i++) {
+			if (total + bufs[i].iob_len > INT_MAX) break;
+			iov[i].iov_base = bufs[i].iob_buf;
+			iov[i].iov_len  = bufs[i].iob_len;
+			total += bufs[i].iob_len;
+		}
+
+		count = i;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = count;
+
+		error = sendmsg(filp->tx_fd, &msg, MSG_DONTWAIT| MSG_NOSIGNAL);
+		if (error >= 0 || errno != EAGAIN) return error;
+
+		for (i = 0; i < (int)count; i++) {
+			tx_aiobuf *iobp = &req->tx_sendbufs[i];
+
+			if (bufs[i].iob_base != NULL) {
+				*iobp = bufs[i];
+				tx_aiobuf_hold(iobp);
+			} else if (tx_aiobuf_alloc(iobp,
+						tx_loop_get(&uring->uring_poll.tx_task), bufs[i].iob_len) == 0) {
+				memcpy(iobp->iob_buf, bufs[i].iob_buf, bufs[i].iob_len);
+			} else {
+				req->tx_sendnbuf = i;
+				tx_uring_sendput(req);
+				errno = ENOMEM;
+				return -1;
+			}
+		}
+
+		req->tx_sendnbuf = count;
+		req->tx_sendoff = 0;
+		req->tx_sendlen = total;
+		tx_uring_send(uring, req);
+
+		filp->tx_flags &= ~TX_WRITABLE;
+		filp->tx_flags |= TX_POLLOUT;
+		return total;
+	}
+
+	errno = EAGAIN;
+	return -1;
+}
+
+int tx_uring_connect(tx_aiocb *filp, void *buf, size_t len)
+{
+	int flags;
+	tx_uring_t *uring;
+	tx_uring_req_t *req;
+	struct io_uring_sqe *sqe;
+	uring = container_of(filp->tx_poll, tx_uring_t, uring_poll);
+	TX_ASSERT(filp->tx_poll->tx_ops == &_uring_ops);
+
+	if ((filp->tx_flags & TX_POLLOUT) == 0x0) {
+		flags = TX_ATTACHED | TX_DETACHED;
+		TX_ASSERT((filp->tx_flags & flags) == TX_ATTACHED);
+
+		req = (tx_uring_req_t *)filp->tx_privp;
+		TX_ASSERT(len <= sizeof(req->tx_addr));
+		memcpy(&req->tx_addr, buf, len);
+
+		sqe = tx_uring_prep(uring, req, IORING_OP_CONNECT);
+		sqe->addr = (unsigned long)&req->tx_addr;
+		sqe->off = len;
+		sqe->user_data = (unsigned long)&req->tx_send;
+
+		req->tx_send.tx_op = URING_CONNECT;
+		tx_uring_hold(uring, req);
+
+		filp->tx_flags &= ~(TX_WRITABLE| TX_READABLE);
+		filp->tx_flags |= TX_POLLOUT;
+		return -EINPROGRESS;
+	}
+
+	return -EALREADY;
+}
+
+static void tx_uring_push(tx_uring_req_t *req, int res, tx_aiobuf *buf)
+{
+	tx_uring_ent_t *ent;
+
+	if (req->tx_qtail == req->tx_qsize) {
+		if (req->tx_qhead > 0) {
+			memmove(req->tx_queue, req->tx_queue + req->tx_qhead,
+					(req->tx_qtail - req->tx_qhead) * sizeof(*ent));
+			req->tx_qtail -= req->tx_qhead;
+			req->tx_qhead = 0;
+		} else {
+			req->tx_qsize = (req->tx_qsize? req->tx_qsize * 2: 16);
+			ent = (tx_uring_ent_t *)realloc(req->tx_queue, req->tx_qsize * sizeof(*ent));
+			TX_PANIC(ent != NULL, "grow uring queue failure");
+			req->tx_queue = ent;
+		}
+	}
+
+	ent = &req->tx_queue[req->tx_qtail++];
+	ent->tx_res = res;
+	ent->tx_buf = *buf;
+	return;
+}
+
+static int tx_uring_pop(tx_aiocb *filp, tx_uring_req_t *req, tx_aiobuf *buf)
+{
+	tx_uring_ent_t *ent;
+
+	if (req->tx_qhead == req->tx_qtail) {
+		filp->tx_flags &= ~TX_READABLE;
+		errno = EAGAIN;
+		return -1;
+	}
+
+	ent = &req->tx_queue[req->tx_qhead++];
+	if (req->tx_qhead == req->tx_qtail) {
+		req->tx_qhead = 0;
+		req->tx_qtail = 0;
+	}
+
+	if (buf != NULL) {
+		*buf = ent->tx_buf;
+	}
+
+	if (ent->tx_res < 0) {
+		errno = -ent->tx_res;
+		return -1;
+	}
+
+	return ent->tx_res;
+}
+
+int tx_uring_accept(tx_aiocb *filp, void *buf, size_t *len)
+{
+	int newfd;
+	socklen_t salen;
+	tx_uring_req_t *req;
+	req = (tx_uring_req_t *)filp->tx_privp;
+	TX_ASSERT(filp->tx_flags & TX_LISTEN);
+
+	newfd = tx_uring_pop(filp, req, NULL);
+	if (newfd != -1 && buf != NULL && len != NULL) {
+		salen = *len;
+		getpeername(newfd, (struct sockaddr *)buf, &salen);
+		*len = salen;
+	}
+
+	return newfd;
+}
+
+void tx_uring_pollout(tx_aiocb *filp)
+{
+	int flags;
+	tx_uring_t *uring;
+	tx_uring_req_t *req;
+	struct io_uring_sqe *sqe;
+	uring = container_of(filp->tx_poll, tx_uring_t, uring_poll);
+	TX_ASSERT(filp->tx_poll->tx_ops == &_uring_ops);
+
+	if ((filp->tx_flags & TX_POLLOUT) == 0x0) {
+		flags = TX_ATTACHED | TX_DETACHED;
+		TX_ASSERT((filp->tx_flags & flags) == TX_ATTACHED);
+
+		req = (tx_uring_req_t *)filp->tx_privp;
+		sqe = tx_uring_prep(uring, req, IORING_OP_POLL_ADD);
+		sqe->poll32_events = POLLOUT;
+		sqe->user_data = (unsigned long)&req->tx_send;
+
+		req->tx_send.tx_op = URING_POLLOUT;
+		tx_uring_hold(uring, req);
+		filp->tx_flags |= TX_POLLOUT;
+	}
+
+	return;
+}
+
+void tx_uring_attach(tx_aiocb *filp)
+{
+	int flags, tflag;
+	tx_uring_t *uring;
+	tx_uring_req_t *req;
+	uring = container_of(filp->tx_poll, tx_uring_t, uring_poll);
+	TX_ASSERT(filp->tx_poll->tx_ops == &_uring_ops);
+
+	flags = TX_ATTACHED| TX_DETACHED;
+	tflag = (filp->tx_flags & flags);
+
+	if (tflag == 0 || tflag == flags) {
+		req = new tx_uring_req_t;
+		TX_PANIC(req != NULL, "allocate uring request failure");
+		memset(req, 0, sizeof(*req));
+		LIST_INSERT_HEAD(&uring->uring_list, req, entries);
+		req->tx_send.tx_req = req;
+		req->tx_recv.tx_req = req;
+		req->tx_filp = filp;
+		req->tx_refcnt = 1;
+		req->tx_slot = -1;
+
+		if (uring->uring_nslot > 0 &&
+				tx_uring_files_update(uring, uring->uring_slots[uring->uring_nslot - 1], filp->tx_fd) == 1) {
+			/* registered file, sqes skip the fd table lookup */
+			req->tx_slot = uring->uring_slots[--uring->uring_nslot];
+		}
+
+		filp->tx_privp = req;
+		filp->tx_flags &= ~TX_DETACHED;
+		filp->tx_flags |= TX_ATTACHED;
+	}
+
+	return;
+}
+
+void tx_uring_pollin(tx_aiocb *filp)
+{
+	int flags;
+	tx_uring_t *uring;
+	tx_uring_req_t *req;
+	struct io_uring_sqe *sqe;
+	uring = container_of(filp->tx_poll, tx_uring_t, uring_poll);
+	TX_ASSERT(filp->tx_poll->tx_ops == &_uring_ops);
+
+	if ((filp->tx_flags & TX_POLLIN) == 0x0) {
+		flags = TX_ATTACHED | TX_DETACHED;
+		TX_ASSERT((filp->tx_flags & flags) == TX_ATTACHED);
+
+		req = (tx_uring_req_t *)filp->tx_privp;
+		if ((filp->tx_flags & (TX_LISTEN| TX_MSHOTRECV)) == TX_MSHOTRECV &&
+				(uring->uring_mode & TX_URING_FIXEDBUF)) {
+			req->tx_recvfix = tx_uring_fixget(uring);
+			if (req->tx_recvfix == NULL) {
+				/* every fixed buffer is in use, tx_uring_fixput rearm us */
+				tx_uring_park(uring, req);
+				return;
+			}
+		}
+
+		if (filp->tx_flags & TX_LISTEN) {
+			sqe = tx_uring_prep(uring, req, IORING_OP_ACCEPT);
+			sqe->accept_flags = SOCK_NONBLOCK| SOCK_CLOEXEC;
+			if (~uring->uring_flags & URING_NOMSHOT)
+				sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+			req->tx_recv.tx_op = URING_ACCEPT;
+		} else if (req->tx_recvfix != NULL) {
+			sqe = tx_uring_prep(uring, req, IORING_OP_READ_FIXED);
+			sqe->addr = (unsigned long)req->tx_recvfix->ub_mem.iob_alloc;
+			sqe->len = URING_FIXSIZE;
+			sqe->off = (unsigned long long)-1;
+			sqe->buf_index = req->tx_recvfix->ub_bid;
+			req->tx_recv.tx_op = URING_READ;
+		} else if ((filp->tx_flags & TX_MSHOTRECV) &&
+				!(uring->uring_mode & TX_URING_FIXEDBUF)) {
+			sqe = tx_uring_prep(uring, req, IORING_OP_RECV);
+			sqe->flags |= IOSQE_BUFFER_SELECT;
+			sqe->buf_group = URING_BGID;
+			if (~uring->uring_flags & URING_NOMSHOT)
+				sqe->ioprio = IORING_RECV_MULTISHOT;
+			req->tx_recv.tx_op = URING_RECV;
+		} else {
+			sqe = tx_uring_prep(uring, req, IORING_OP_POLL_ADD);
+			sqe->poll32_events = POLLIN;
+			req->tx_recv.tx_op = URING_POLLIN;
+		}
+
+		sqe->user_data = (unsigned long)&req->tx_recv;
+		tx_uring_hold(uring, req);
+		filp->tx_flags &= ~TX_CANCELIN;
+		filp->tx_flags |= TX_POLLIN;
+	}
+
+	return;
+}
+
+static void tx_uring_cancel(tx_uring_t *uring, tx_uring_op_t *op)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = tx_uring_sqe(uring);
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (unsigned long)op;
+	sqe->user_data = 0;
+	return;
+}
+
+static void tx_uring_park(tx_uring_t *uring, tx_uring_req_t *req)
+{
+	req->tx_filp->tx_flags |= (TX_POLLIN| TX_BUFWAIT);
+	TAILQ_INSERT_TAIL(&uring->uring_parked, req, tx_parked);
+	return;
+}
+
+static void tx_uring_unpark(tx_uring_t *uring)
+{
+	tx_uring_req_t *req;
+
+	req = TAILQ_FIRST(&uring->uring_parked);
+	if (req != NULL) {
+		TAILQ_REMOVE(&uring->uring_parked, req, tx_parked);
+		req->tx_filp->tx_flags &= ~(TX_POLLIN| TX_BUFWAIT);
+		tx_uring_pollin(req->tx_filp);
+	}
+
+	return;
+}
+
+static void tx_uring_release(tx_uring_t *uring, tx_uring_req_t *req)
+{
+	tx_uring_ent_t *ent;
+
+	if (--req->tx_refcnt == 0) {
+		if (req->tx_slot >= 0) {
+			/* no sqe refer to the slot any more, it can go to the next attach */
+			uring->uring_slots[uring->uring_nslot++] = req->tx_slot;
+			req->tx_slot = -1;
+		}
+
+		for (int i = req->tx_qhead; i < req->tx_qtail; i++) {
+			ent = &req->tx_queue[i];
+			if (ent->tx_buf.iob_base != NULL)
+				tx_aiobuf_drop(&ent->tx_buf);
+			else if (req->tx_recv.tx_op == URING_ACCEPT && ent->tx_res >= 0)
+				close(ent->tx_res);
+		}
+
+		if (req->tx_sendfix != NULL)
+			tx_membuf_drop(&req->tx_sendfix->ub_mem);
+
+		tx_uring_sendput(req);
+		free(req->tx_queue);
+		LIST_REMOVE(req, entries);
+		delete req;
+	}
+
+	return;
+}
+
+void tx_uring_detach(tx_aiocb *filp)
+{
+	int flags, tflag;
+	tx_uring_t *uring;
+	tx_uring_req_t *req;
+	uring = container_of(filp->tx_poll, tx_uring_t, uring_poll);
+	TX_ASSERT(filp->tx_poll->tx_ops == &_uring_ops);
+
+	flags = TX_ATTACHED| TX_DETACHED;
+	tflag = (filp->tx_flags & flags);
+
+	if (tflag == TX_ATTACHED) {
+		req = (tx_uring_req_t *)filp->tx_privp;
+		if (filp->tx_flags & TX_BUFWAIT) {
+			TAILQ_REMOVE(&uring->uring_parked, req, tx_parked);
+			filp->tx_flags &= ~(TX_POLLIN| TX_BUFWAIT);
+		}
+
+		if (filp->tx_flags & TX_POLLIN)
+			tx_uring_cancel(uring, &req->tx_recv);
+		if (filp->tx_flags & TX_POLLOUT)
+			tx_uring_cancel(uring, &req->tx_send);
+
+		/* the fd may be closed and its number reused as soon as we return */
+		tx_uring_flush(uring);
+
+		if (req->tx_slot >= 0) {
+			/*
+			 * drop the file from the slot so close() really close it, the
+			 * slot itself stay reserved until the cancel completions are
+			 * reaped and tx_uring_release return it.
+			 */
+			tx_uring_files_update(uring, req->tx_slot, -1);
+		}
+
+		filp->tx_flags |= TX_DETACHED;
+		filp->tx_privp = NULL;
+		req->tx_filp = NULL;
+		tx_uring_release(uring, req);
+	}
+
+	return;
+}
+
+static void tx_uring_recycle(tx_membuf *mbp)
+{
+	tx_uring_t *uring;
+	tx_uring_buf_t *ubp;
+	struct io_uring_buf *bufp;
+
+	ubp = container_of(mbp, tx_uring_buf_t, ub_mem);
+	uring = ubp->ub_uring;
+
+	/* the bufs flex array is misplaced when the uapi header is built as c++ */
+	bufp = (struct io_uring_buf *)uring->uring_bufring;
+	bufp += (uring->uring_buftail & (uring->uring_bufcount - 1));
+	bufp->addr = (unsigned long)mbp->iob_alloc;
+	bufp->len  = uring->uring_bufsize;
+	bufp->bid  = ubp->ub_bid;
+
+	uring->uring_buftail++;
+	__atomic_store_n(&uring->uring_bufring->tail, uring->uring_buftail, __ATOMIC_RELEASE);
+
+	uring->uring_bufout--;
+	tx_uring_unpark(uring);
+	return;
+}
+
+static void tx_uring_multishot(tx_uring_t *uring, tx_aiocb *filp, struct io_uring_cqe *cqe, tx_aiobuf *iobp)
+{
+	int count;
+	tx_uring_req_t *req;
+	int more = (cqe->flags & IORING_CQE_F_MORE);
+
+	req = (tx_uring_req_t *)filp->tx_privp;
+	if (more == 0) {
+		filp->tx_flags &= ~(TX_POLLIN| TX_CANCELIN);
+	} else {
+		uring->uring_flags |= URING_MSHOTOK;
+	}
+
+	if (cqe->res == -EINVAL && more == 0 &&
+			(uring->uring_flags & (URING_NOMSHOT| URING_MSHOTOK)) == 0) {
+		/* kernel without multishot support, fall back to one shot */
+		uring->uring_flags |= URING_NOMSHOT;
+		tx_uring_pollin(filp);
+		return;
+	}
+
+	if (more || (cqe->res != -ECANCELED && cqe->res != -ENOBUFS)) {
+		/* out of provided buffers is not an error, rearm when owner ask again */
+		tx_uring_push(req, cqe->res, iobp);
+	}
+
+	count = req->tx_qtail - req->tx_qhead;
+	if (count >= URING_QUEUE_HIGH && more &&
+			(filp->tx_flags & TX_CANCELIN) == 0) {
+		/* owner is not keeping up, stop the multishot until the queue drain */
+		tx_uring_cancel(uring, &req->tx_recv);
+		filp->tx_flags |= TX_CANCELIN;
+	}
+
+	if (count > 0) {
+		filp->tx_flags |= TX_READABLE;
+		tx_aincb_wakeup(filp);
+	} else if (more == 0 && cqe->res == -ENOBUFS &&
+			uring->uring_bufout == uring->uring_bufcount) {
+		/* every buffer is held by the owners, rearm when one come back */
+		tx_uring_park(uring, req);
+	} else if (more == 0 && filp->tx_filterin != NULL) {
+		tx_uring_pollin(filp);
+	}
+
+	return;
+}
+
+static void tx_uring_complete(tx_uring_t *uring, struct io_uring_cqe *cqe)
+{
+	int more;
+	tx_aiocb *filp;
+	tx_aiobuf iob;
+	tx_uring_op_t *op;
+	tx_uring_req_t *req;
+	tx_uring_buf_t *ubp;
+
+	op = (tx_uring_op_t *)cqe->user_data;
+	if (op == NULL) {
+		/* cancel or timeout request */
+		return;
+	}
+
+	req = op->tx_req;
+	filp = req->tx_filp;
+	more = (cqe->flags & IORING_CQE_F_MORE);
+
+	iob.iob_buf = NULL;
+	iob.iob_len = 0;
+	iob.iob_base = NULL;
+
+	if (cqe->flags & IORING_CQE_F_BUFFER) {
+		ubp = &uring->uring_bufs[cqe->flags >> IORING_CQE_BUFFER_SHIFT];
+		ubp->ub_mem.iob_use = 1;
+		uring->uring_bufout++;
+		iob.iob_buf = (char *)ubp->ub_mem.iob_alloc;
+		iob.iob_len = (cqe->res > 0? cqe->res: 0);
+		iob.iob_base = &ubp->ub_mem;
+	}
+
+	if (op->tx_op == URING_READ) {
+		ubp = req->tx_recvfix;
+		req->tx_recvfix = NULL;
+		iob.iob_buf = (char *)ubp->ub_mem.iob_alloc;
+		iob.iob_len = (cqe->res > 0? cqe->res: 0);
+		iob.iob_base = &ubp->ub_mem;
+		if (cqe->res <= 0) tx_aiobuf_drop(&iob);
+	}
+
+	if (op->tx_op == URING_SEND && req->tx_sendfix != NULL &&
+			(cqe->res <= 0 || req->tx_sendoff + cqe->res >= req->tx_sendlen)) {
+		tx_membuf_drop(&req->tx_sendfix->ub_mem);
+		req->tx_sendfix = NULL;
+	}
+
+	if (op->tx_op == URING_SEND && req->tx_sendnbuf > 0 &&
+			(cqe->res <= 0 || req->tx_sendoff + cqe->res >= req->tx_sendlen)) {
+		tx_uring_sendput(req);
+	}
+
+	if (filp == NULL) {
+		tx_aiobuf_drop(&iob);
+		if (op->tx_op == URING_ACCEPT && cqe->res >= 0)
+			close(cqe->res);
+		goto release;
+	}
+
+	switch (op->tx_op) {
+		case URING_SEND:
+			if (cqe->res > 0 && req->tx_sendoff + cqe->res < req->tx_sendlen) {
+				/* partial send, chain the rest */
+				req->tx_sendoff += cqe->res;
+				tx_uring_send(uring, req);
+				break;
+			}
+
+			if (cqe->res < 0) {
+				/* the byte were reported written, fail the next send instead */
+				req->tx_senderr = -cqe->res;
+			}
+			/* fall through */
+
+		case URING_POLLOUT:
+			filp->tx_flags &= ~TX_POLLOUT;
+			filp->tx_flags |= TX_WRITABLE;
+			tx_outcb_wakeup(filp);
+			break;
+
+		case URING_CONNECT:
+			filp->tx_flags &= ~TX_POLLOUT;
+			filp->tx_flags |= TX_WRITABLE;
+			filp->tx_flags |= (cqe->res < 0? TX_READABLE: 0);
+			tx_outcb_wakeup(filp);
+			break;
+
+		case URING_ACCEPT:
+		case URING_RECV:
+			tx_uring_multishot(uring, filp, cqe, &iob);
+			break;
+
+		case URING_READ:
+			if (cqe->res != -ECANCELED)
+				tx_uring_push(req, cqe->res, &iob);
+			/* fall through */
+
+		case URING_POLLIN:
+			filp->tx_flags &= ~TX_POLLIN;
+			filp->tx_flags |= TX_READABLE;
+			tx_aincb_wakeup(filp);
+			break;
+	}
+
+release:
+	if (more == 0) {
+		uring->uring_refcnt--;
+		tx_uring_release(uring, req);
+	}
+
+	return;
+}
+
+static void tx_uring_polling(void *up)
+{
+	int error;
+	int timeout;
+	unsigned head, tail;
+	tx_loop_t *loop;
+	tx_uring_t *uring;
+
+	uring = (tx_uring_t *)up;
+	loop = tx_loop_get(&uring->uring_poll.tx_task);
+	timeout = tx_loop_timeout(loop, uring);
+
+	if (timeout && !(uring->uring_features & IORING_FEAT_EXT_ARG)) {
+		/* old kernel, bound the wait with a timeout sqe */
+		struct io_uring_sqe *sqe = tx_uring_sqe(uring);
+		uring->uring_ts.tv_sec = 0;
+		uring->uring_ts.tv_nsec = 10000000;
+		sqe->opcode = IORING_OP_TIMEOUT;
+		sqe->fd = -1;
+		sqe->addr = (unsigned long)&uring->uring_ts;
+		sqe->len = 1;
+		sqe->user_data = 0;
+	}
+
+	tx_poll_waitstart(&uring->uring_poll);
+	error = tx_uring_submit(uring, timeout? 1: 0, 10);
+	TX_PANIC(error >= 0 || errno == EINTR || errno == ETIME || errno == EBUSY, "io_uring_enter");
+
+	head = *uring->uring_cqhead;
+	tail = __atomic_load_n(uring->uring_cqtail, __ATOMIC_ACQUIRE);
+	tx_poll_waitdone(&uring->uring_poll,
+			(error < 0 && errno != ETIME)? -1: (int)(tail - head));
+
+	while (head != tail) {
+		tx_uring_complete(uring, &uring->uring_cqes[head & *uring->uring_cqmask]);
+		head++;
+	}
+
+	__atomic_store_n(uring->uring_cqhead, head, __ATOMIC_RELEASE);
+
+#ifndef DISABLE_MULTI_POLLER
+	if (loop->tx_holder == uring &&
+			uring->uring_refcnt == 0)
+		loop->tx_holder = NULL;
+#endif
+
+	tx_poll_active(&uring->uring_poll);
+	return;
+}
+
+static int tx_uring_setup(tx_uring_t *uring, unsigned entries, int mode, unsigned sqidle)
+{
+	int fd = -1;
+	char *sqring, *cqring;
+	struct io_uring_params params;
+
+	if (mode & TX_URING_SQPOLL) {
+		memset(&params, 0, sizeof(params));
+		params.flags = IORING_SETUP_SQPOLL;
+		params.sq_thread_idle = sqidle;
+		fd = syscall(__NR_io_uring_setup, entries, &params);
+		TX_CHECK(fd != -1, "io_uring sqpoll not available");
+	}
+
+	if (fd == -1) {
+		mode &= ~TX_URING_SQPOLL;
+		memset(&params, 0, sizeof(params));
+		fd = syscall(__NR_io_uring_setup, entries, &params);
+	}
+
+	if (fd == -1) {
+		LOG_DEBUG("io_uring_setup failure %d, %s", errno, strerror(errno));
+		return -1;
+	}
+
+	uring->uring_mode = mode;
+	uring->uring_fd = fd;
+	uring->uring_features = params.features;
+	uring->uring_sqsize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	uring->uring_cqsize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	uring->uring_sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		uring->uring_sqsize = max(uring->uring_sqsize, uring->uring_cqsize);
+		uring->uring_cqsize = 0;
+	}
+
+	sqring = (char *)mmap(0, uring->uring_sqsize, PROT_READ| PROT_WRITE,
+			MAP_SHARED| MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	uring->uring_sqring = sqring;
+	uring->uring_cqring = NULL;
+	uring->uring_sqes = (struct io_uring_sqe *)MAP_FAILED;
+	if (sqring == MAP_FAILED) goto clean;
+
+	cqring = sqring;
+	if (uring->uring_cqsize > 0) {
+		cqring = (char *)mmap(0, uring->uring_cqsize, PROT_READ| PROT_WRITE,
+				MAP_SHARED| MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		uring->uring_cqring = cqring;
+		if (cqring == MAP_FAILED) goto clean;
+	}
+
+	uring->uring_sqes = (struct io_uring_sqe *)mmap(0, uring->uring_sqessize,
+			PROT_READ| PROT_WRITE, MAP_SHARED| MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (uring->uring_sqes == MAP_FAILED) goto clean;
+
+	uring->uring_sqhead = (unsigned *)(sqring + params.sq_off.head);
+	uring->uring_sqtail = (unsigned *)(sqring + params.sq_off.tail);
+	uring->uring_sqflags = (unsigned *)(sqring + params.sq_off.flags);
+	uring->uring_sqlocal = *uring->uring_sqtail;
+	uring->uring_sqmask = (unsigned *)(sqring + params.sq_off.ring_mask);
+	uring->uring_sqarray = (unsigned *)(sqring + params.sq_off.array);
+	uring->uring_sqentries = params.sq_entries;
+
+	uring->uring_cqhead = (unsigned *)(cqring + params.cq_off.head);
+	uring->uring_cqtail = (unsigned *)(cqring + params.cq_off.tail);
+	uring->uring_cqmask = (unsigned *)(cqring + params.cq_off.ring_mask);
+	uring->uring_cqes = (struct io_uring_cqe *)(cqring + params.cq_off.cqes);
+	return 0;
+
+clean:
+	LOG_DEBUG("io_uring mmap failure %d, %s", errno, strerror(errno));
+	if (uring->uring_sqes != MAP_FAILED)
+		munmap(uring->uring_sqes, uring->uring_sqessize);
+	if (uring->uring_cqring != NULL && uring->uring_cqring != MAP_FAILED)
+		munmap(uring->uring_cqring, uring->uring_cqsize);
+	if (uring->uring_sqring != MAP_FAILED)
+		munmap(uring->uring_sqring, uring->uring_sqsize);
+	close(fd);
+	return -1;
+}
+
+static void tx_uring_register(tx_uring_t *uring)
+{
+	int error;
+	int *fds = NULL;
+	struct iovec *iov = NULL;
+
+	if (uring->uring_mode & TX_URING_FIXEDFILE) {
+		fds = (int *)malloc(URING_FILES * sizeof(int));
+		uring->uring_slots = (int *)malloc(URING_FILES * sizeof(int));
+		TX_PANIC(fds != NULL && uring->uring_slots != NULL, "allocate io_uring files failure");
+
+		for (int i = 0; i < URING_FILES; i++) {
+			fds[i] = -1;
+			uring->uring_slots[i] = URING_FILES - 1 - i;
+		}
+
+		error = syscall(__NR_io_uring_register, uring->uring_fd, IORING_REGISTER_FILES, fds, URING_FILES);
+		TX_CHECK(error == 0, "io_uring register files failure");
+		uring->uring_nslot = (error == 0? URING_FILES: 0);
+		uring->uring_mode &= (error == 0? ~0: ~TX_URING_FIXEDFILE);
+		free(fds);
+	}
+
+	if (uring->uring_mode & TX_URING_FIXEDBUF) {
+		char *base = (char *)malloc(URING_FIXCOUNT * URING_FIXSIZE);
+		iov = (struct iovec *)malloc(URING_FIXCOUNT * sizeof(*iov));
+		uring->uring_fixed = (tx_uring_buf_t *)malloc(URING_FIXCOUNT * sizeof(tx_uring_buf_t));
+		uring->uring_fixfree = (tx_uring_buf_t **)malloc(URING_FIXCOUNT * sizeof(tx_uring_buf_t *));
+		TX_PANIC(base && iov && uring->uring_fixed && uring->uring_fixfree, "allocate io_uring fixed buffer failure");
+
+		for (int i = 0; i < URING_FIXCOUNT; i++) {
+			tx_uring_buf_t *ubp = &uring->uring_fixed[i];
+			ubp->ub_bid = i;
+			ubp->ub_uring = uring;
+			ubp->ub_mem.iob_use = 0;
+			ubp->ub_mem.iob_alloc = base + i * URING_FIXSIZE;
+			ubp->ub_mem.iob_release = tx_uring_fixput;
+			iov[i].iov_base = ubp->ub_mem.iob_alloc;
+			iov[i].iov_len = URING_FIXSIZE;
+			uring->uring_fixfree[URING_FIXCOUNT - 1 - i] = ubp;
+		}
+
+		error = syscall(__NR_io_uring_register, uring->uring_fd, IORING_REGISTER_BUFFERS, iov, URING_FIXCOUNT);
+		TX_CHECK(error == 0, "io_uring register buffers failure");
+		uring->uring_nfixfree = (error == 0? URING_FIXCOUNT: 0);
+		uring->uring_mode &= (error == 0? ~0: ~TX_URING_FIXEDBUF);
+		free(iov);
+	}
+
+	return;
+}
+#endif
+
+tx_poll_t *tx_uring_init(tx_loop_t *loop)
+{
+	return tx_uring_init(loop, 0, 0);
+}
+
+tx_poll_t *tx_uring_init(tx_loop_t *loop, int flags, unsigned sqidle)
+{
+	tx_task_t *np = 0;
+	tx_task_q *taskq = &loop->tx_taskq;
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	if (loop->tx_poller != NULL &&
+		loop->tx_poller->tx_ops == &_uring_ops) {
+		LOG_ERROR("io_uring aready created");
+		return loop->tx_poller;
+	}
+
+	LIST_FOREACH(np, taskq, entries)
+		if (np->tx_call == tx_uring_polling)
+			return container_of(np, tx_poll_t, tx_task);
+
+	tx_uring_t *poll = (tx_uring_t *)malloc(sizeof(tx_uring_t));
+	TX_CHECK(poll != NULL, "create io_uring failure");
+
+	if (poll != NULL && tx_uring_setup(poll, URING_ENTRIES, flags, sqidle) == 0) {
+		tx_poll_init(&poll->uring_poll, loop, tx_uring_polling, poll);
+		tx_poll_active(&poll->uring_poll);
+		poll->uring_poll.tx_ops = &_uring_ops;
+		loop->tx_poller = &poll->uring_poll;
+		LIST_INIT(&poll->uring_list);
+		TAILQ_INIT(&poll->uring_parked);
+#ifdef DISABLE_MULTI_POLLER
+		loop->tx_holder = poll;
+#endif
+		poll->uring_flags = 0;
+		poll->uring_refcnt = 0;
+		poll->uring_bufs = NULL;
+		poll->uring_bufbase = NULL;
+		poll->uring_bufring = NULL;
+		poll->uring_bufcount = 0;
+		poll->uring_bufout = 0;
+		poll->uring_slots = NULL;
+		poll->uring_nslot = 0;
+		poll->uring_fixed = NULL;
+		poll->uring_fixfree = NULL;
+		poll->uring_nfixfree = 0;
+		tx_uring_register(poll);
+		return &poll->uring_poll;
+	}
+
+	free(poll);
+#endif
+
+	TX_UNUSED(taskq);
+	TX_UNUSED(np);
+	TX_UNUSED(flags);
+	TX_UNUSED(sqidle);
+	return NULL;
+}
+
+int tx_uring_bufring(tx_poll_t *poll, unsigned count, unsigned size)
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	int error;
+	char *base;
+	size_t ringsize;
+	tx_uring_t *uring;
+	tx_uring_buf_t *bufs;
+	struct io_uring_buf_reg reg;
+	struct io_uring_buf_ring *ring;
+
+	TX_ASSERT(poll->tx_ops == &_uring_ops);
+	TX_ASSERT(count > 0 && count <= 32768 && (count & (count - 1)) == 0);
+	uring = container_of(poll, tx_uring_t, uring_poll);
+
+	if (uring->uring_bufring != NULL) {
+		LOG_ERROR("io_uring buffer ring aready created");
+		return -1;
+	}
+
+	ringsize = count * sizeof(struct io_uring_buf);
+	ring = (struct io_uring_buf_ring *)mmap(0, ringsize, PROT_READ| PROT_WRITE, MAP_PRIVATE| MAP_ANONYMOUS, -1, 0);
+	base = (char *)malloc(count * size);
+	bufs = (tx_uring_buf_t *)malloc(count * sizeof(*bufs));
+
+	if (ring == MAP_FAILED || base == NULL || bufs == NULL) {
+		LOG_DEBUG("io_uring buffer ring allocate failure");
+		goto clean;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long)ring;
+	reg.ring_entries = count;
+	reg.bgid = URING_BGID;
+
+	error = syscall(__NR_io_uring_register, uring->uring_fd, IORING_REGISTER_PBUF_RING, &reg, 1);
+	if (error != 0) {
+		LOG_DEBUG("io_uring register buffer ring failure %d, %s", errno, strerror(errno));
+		goto clean;
+	}
+
+	uring->uring_bufs = bufs;
+	uring->uring_bufbase = base;
+	uring->uring_bufring = ring;
+	uring->uring_bufsize = size;
+	uring->uring_bufcount = count;
+	uring->uring_buftail = 0;
+	uring->uring_bufout = count;
+
+	for (unsigned i = 0; i < count; i++) {
+		bufs[i].ub_bid = i;
+		bufs[i].ub_uring = uring;
+		bufs[i].ub_mem.iob_use = 0;
+		bufs[i].ub_mem.iob_alloc = base + i * size;
+		bufs[i].ub_mem.iob_release = tx_uring_recycle;
+		tx_uring_recycle(&bufs[i].ub_mem);
+	}
+
+	return 0;
+
+clean:
+	if (ring != MAP_FAILED)
+		munmap(ring, ringsize);
+	free(base);
+	free(bufs);
+	return -1;
+#else
+	TX_UNUSED(poll);
+	TX_UNUSED(count);
+	TX_UNUSED(size);
+	return -1;
+#endif
+}
+
+int tx_uring_recv(tx_aiocb *filp, tx_aiobuf *buf)
+{
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+	tx_uring_t *uring;
+	tx_uring_req_t *req;
+
+	if (filp->tx_poll->tx_ops != &_uring_ops) {
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	uring = container_of(filp->tx_poll, tx_uring_t, uring_poll);
+	if ((uring->uring_mode & TX_URING_FIXEDBUF) == 0 &&
+			uring->uring_bufring == NULL &&
+			tx_uring_bufring(filp->tx_poll, URING_BUFCOUNT, URING_BUFSIZE) != 0) {
+		errno = ENOBUFS;
+		return -1;
+	}
+
+	req = (tx_uring_req_t *)filp->tx_privp;
+	filp->tx_flags |= TX_MSHOTRECV;
+	buf->iob_base = NULL;
+	return tx_uring_pop(filp, req, buf);
+#else
+	TX_UNUSED(filp);
+	TX_UNUSED(buf);
+	errno = EOPNOTSUPP;
+	return -1;
+#endif
+}
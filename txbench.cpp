@@ -0,0 +1,435 @@
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "txall.h"
+
+/*
+ * timer subsystem benchmark, for each timer count and timeout distribution:
+ *   reset:  ns per tx_timer_reset on an idle timer
+ *   rearm:  ns per tx_timer_reset on an armed timer (unlink + link)
+ *   stop:   ns per tx_timer_stop
+ *   drain:  ns per tx_timer_drain
+ *   expire: cpu ns per expired timer, including the wheel walk and dispatch
+ *   rss:    resident memory with all timers armed
+ *   p50/p99/max: fire lateness in ms (fire tick - deadline tick)
+ *
+ * usage: txbench [max-count] [expire-window-ms]
+ *
+ * stream throughput over socketpairs, per poller and io_uring features:
+ *   usage: txbench stream [epoll|uring] [uring-flags] [pairs] [seconds]
+ *
+ * accept rate from forked loopback clients, batch 0 use tx_listen_accept
+ * plus tx_setblockopt, otherwise tx_listen_acceptv with that batch size:
+ *   usage: txbench accept [batch] [clients] [seconds]
+ */
+
+#define BENCH_MIN_COUNT 1000
+#define BENCH_MAX_COUNT 10000000
+#define BENCH_WINDOW    2000
+#define BENCH_MAX_TIME  60000
+#define BENCH_LONG_TIME 3600000
+#define BENCH_BURSTS    16
+#define BENCH_REFRESH   1024
+#define BENCH_PAIRS     16
+#define BENCH_SECONDS   2
+#define BENCH_CHUNK     4096
+#define BENCH_CLIENTS   4
+#define BENCH_BATCH     64
+
+struct bench_timer {
+	tx_timer_t timer;
+	unsigned deadline;
+};
+
+struct bench_ctx {
+	size_t fired;
+	size_t count;
+	int *late;
+	tx_loop_t *loop;
+};
+
+struct bench_pipe {
+	tx_aiocb in;
+	tx_aiocb out;
+	tx_task_t reader;
+	tx_task_t writer;
+};
+
+typedef unsigned (*bench_dist)(unsigned window);
+
+static struct bench_ctx _bench;
+static unsigned _bench_seed = 0x12345678;
+
+static unsigned bench_rand(void)
+{
+	_bench_seed = _bench_seed * 1103515245 + 12345;
+	return (_bench_seed >> 8);
+}
+
+static unsigned dist_uniform(unsigned window)
+{
+	return 20 + bench_rand() % window;
+}
+
+static unsigned dist_bursty(unsigned window)
+{
+	return (1 + bench_rand() % BENCH_BURSTS) * (window / BENCH_BURSTS);
+}
+
+static unsigned dist_longtail(unsigned window)
+{
+	unsigned t = 20;
+
+	/* P(t >= 20 * 2^k) = 2^-k, pareto like tail */
+	while ((bench_rand() & 1) && t < window)
+		t <<= 1;
+
+	t += bench_rand() % t;
+	return (t < window? t: window);
+}
+
+static unsigned long long bench_nsecs(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static double bench_rss(void)
+{
+	long pages = 0, resident = 0;
+	FILE *fp = fopen("/proc/self/statm", "r");
+
+	if (fp != NULL) {
+		if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+			resident = 0;
+		fclose(fp);
+	}
+
+	return resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+static void bench_callout(void *up)
+{
+	struct bench_timer *bt = (struct bench_timer *)up;
+
+	if (_bench.late != NULL)
+		_bench.late[_bench.fired] = (int)(tx_ticks - bt->deadline);
+
+	if (++_bench.fired == _bench.count)
+		tx_loop_break(_bench.loop);
+
+	return;
+}
+
+static void bench_arm(struct bench_timer *timers, size_t count, bench_dist dist, unsigned window)
+{
+	unsigned timeout;
+
+	for (size_t i = 0; i < count; i++) {
+		if (i % BENCH_REFRESH == 0) tx_getticks();
+		timeout = dist(window);
+		timers[i].deadline = tx_ticks + timeout;
+		tx_timer_reset(&timers[i].timer, timeout);
+	}
+
+	return;
+}
+
+static void bench_wait(size_t count)
+{
+	_bench.fired = 0;
+	_bench.count = count;
+	tx_loop_main(_bench.loop);
+	return;
+}
+
+static int late_compare(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+static void bench_run(const char *name, bench_dist dist, size_t count, unsigned window)
+{
+	double rss;
+	unsigned long long start;
+	double reset, rearm, stop, drain, expire;
+	struct bench_timer *timers;
+
+	timers = (struct bench_timer *)malloc(count * sizeof(*timers));
+	TX_PANIC(timers != NULL, "allocate bench timer failure");
+
+	for (size_t i = 0; i < count; i++)
+		tx_timer_init(&timers[i].timer, _bench.loop, bench_callout, &timers[i]);
+
+	start = bench_nsecs(CLOCK_MONOTONIC);
+	bench_arm(timers, count, dist, BENCH_LONG_TIME);
+	reset = (double)(bench_nsecs(CLOCK_MONOTONIC) - start) / count;
+
+	start = bench_nsecs(CLOCK_MONOTONIC);
+	bench_arm(timers, count, dist, BENCH_LONG_TIME);
+	rearm = (double)(bench_nsecs(CLOCK_MONOTONIC) - start) / count;
+	rss = bench_rss();
+
+	start = bench_nsecs(CLOCK_MONOTONIC);
+	for (size_t i = 0; i < count; i++)
+		tx_timer_stop(&timers[i].timer);
+	stop = (double)(bench_nsecs(CLOCK_MONOTONIC) - start) / count;
+
+	bench_arm(timers, count, dist, BENCH_MAX_TIME);
+	start = bench_nsecs(CLOCK_MONOTONIC);
+	for (size_t i = 0; i < count; i++)
+		tx_timer_drain(&timers[i].timer);
+	drain = (double)(bench_nsecs(CLOCK_MONOTONIC) - start) / count;
+	bench_wait(count);
+
+	_bench.late = (int *)malloc(count * sizeof(int));
+	TX_PANIC(_bench.late != NULL, "allocate bench late failure");
+
+	bench_arm(timers, count, dist, window);
+	start = bench_nsecs(CLOCK_PROCESS_CPUTIME_ID);
+	bench_wait(count);
+	expire = (double)(bench_nsecs(CLOCK_PROCESS_CPUTIME_ID) - start) / count;
+
+	qsort(_bench.late, count, sizeof(int), late_compare);
+	fprintf(stdout, "%-9s %9zu %8.1f %8.1f %8.1f %8.1f %8.1f %9.1f %6d %6d %6d\n",
+			name, count, reset, rearm, stop, drain, expire, rss,
+			_bench.late[count / 2], _bench.late[count * 99 / 100], _bench.late[count - 1]);
+	fflush(stdout);
+
+	free(_bench.late);
+	_bench.late = NULL;
+	free(timers);
+	return;
+}
+
+static int _bench_uring = 0;
+static size_t _bench_bytes = 0;
+static char _bench_chunk[BENCH_CHUNK];
+
+static void stream_read(void *up)
+{
+	int n;
+	tx_aiobuf iob;
+	char buf[BENCH_CHUNK];
+	struct bench_pipe *bp = (struct bench_pipe *)up;
+
+	for (;;) {
+		if (_bench_uring) {
+			n = tx_uring_recv(&bp->in, &iob);
+			if (n > 0) tx_aiobuf_drop(&iob);
+		} else {
+			n = recv(bp->in.tx_fd, buf, sizeof(buf), 0);
+			tx_aincb_update(&bp->in, n);
+		}
+
+		if (n <= 0) break;
+		_bench_bytes += n;
+	}
+
+	if (n == -1 && errno == EAGAIN)
+		tx_aincb_active(&bp->in, &bp->reader);
+
+	return;
+}
+
+static void stream_write(void *up)
+{
+	struct bench_pipe *bp = (struct bench_pipe *)up;
+
+	while (tx_outcb_write(&bp->out, _bench_chunk, sizeof(_bench_chunk)) > 0);
+	tx_outcb_prepare(&bp->out, &bp->writer, 0);
+	return;
+}
+
+static void stream_stop(void *up)
+{
+	tx_loop_stop((tx_loop_t *)up);
+	return;
+}
+
+static int stream_main(int argc, char *argv[])
+{
+	int fds[2];
+	tx_poll_t *poll;
+	tx_timer_t timer;
+	struct bench_pipe *pipes;
+	unsigned long long start;
+	const char *poller = (argc > 0? argv[0]: "epoll");
+	int flags = (argc > 1? strtol(argv[1], NULL, 0): 0);
+	int count = (argc > 2? strtol(argv[2], NULL, 0): BENCH_PAIRS);
+	int seconds = (argc > 3? strtol(argv[3], NULL, 0): BENCH_SECONDS);
+
+	_bench.loop = tx_loop_default();
+	_bench_uring = !strcmp(poller, "uring");
+	poll = _bench_uring? tx_uring_init(_bench.loop, flags, 1000): tx_epoll_init(_bench.loop);
+	TX_PANIC(poll != NULL, "create bench poller failure");
+
+	pipes = (struct bench_pipe *)calloc(count, sizeof(*pipes));
+	TX_PANIC(pipes != NULL, "allocate bench pipe failure");
+
+	for (int i = 0; i < count; i++) {
+		TX_PANIC(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair");
+		tx_setblockopt(fds[0], 0);
+		tx_setblockopt(fds[1], 0);
+		tx_aiocb_init(&pipes[i].in, poll, fds[0]);
+		tx_aiocb_init(&pipes[i].out, poll, fds[1]);
+		tx_task_init(&pipes[i].reader, _bench.loop, stream_read, &pipes[i]);
+		tx_task_init(&pipes[i].writer, _bench.loop, stream_write, &pipes[i]);
+		tx_task_active(&pipes[i].reader, NULL);
+		tx_task_active(&pipes[i].writer, NULL);
+	}
+
+	tx_timer_init(&timer, _bench.loop, stream_stop, _bench.loop);
+	tx_timer_reset(&timer, seconds * 1000);
+
+	start = bench_nsecs(CLOCK_MONOTONIC);
+	tx_loop_main(_bench.loop);
+	start = bench_nsecs(CLOCK_MONOTONIC) - start;
+
+	fprintf(stdout, "%-6s flags %#x pairs %d: %.1f MB/s\n", poller, flags, count,
+			_bench_bytes / (start / 1000000000.0) / (1024.0 * 1024.0));
+	return 0;
+}
+
+static int _bench_batch = 0;
+static size_t _bench_accepts = 0;
+static tx_aiocb _bench_listen;
+static tx_task_t _bench_acceptor;
+
+static void accept_client(struct sockaddr_in *sa)
+{
+	int fd;
+	struct linger lg = {1, 0};
+
+	for (;;) {
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd == -1) continue;
+		/* reset on close, keep the clients out of TIME_WAIT */
+		setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+		connect(fd, (struct sockaddr *)sa, sizeof(*sa));
+		close(fd);
+	}
+
+	return;
+}
+
+static void accept_handle(void *up)
+{
+	int newfd;
+	int newfds[BENCH_BATCH];
+	tx_aiocb *filp = &_bench_listen;
+
+	if (_bench_batch == 0) {
+		while ((newfd = tx_listen_accept(filp, NULL, NULL)) != -1) {
+			tx_setblockopt(newfd, 0);
+			_bench_accepts++;
+			close(newfd);
+		}
+	} else {
+		int count = min(_bench_batch, BENCH_BATCH);
+		while ((newfd = tx_listen_acceptv(filp, newfds, NULL, count)) > 0) {
+			for (int i = 0; i < newfd; i++)
+				close(newfds[i]);
+			_bench_accepts += newfd;
+		}
+	}
+
+	tx_listen_active(filp, &_bench_acceptor);
+	TX_UNUSED(up);
+	return;
+}
+
+static int accept_main(int argc, char *argv[])
+{
+	int fd;
+	int one = 1;
+	tx_timer_t timer;
+	socklen_t salen;
+	struct sockaddr_in sa;
+	unsigned long long start;
+	pid_t pids[BENCH_CLIENTS * 4];
+	int clients = (argc > 1? strtol(argv[1], NULL, 0): BENCH_CLIENTS);
+	int seconds = (argc > 2? strtol(argv[2], NULL, 0): BENCH_SECONDS);
+
+	_bench_batch = (argc > 0? strtol(argv[0], NULL, 0): 0);
+	clients = min(clients, BENCH_CLIENTS * 4);
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	TX_PANIC(fd != -1, "socket");
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	TX_PANIC(bind(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0, "bind");
+	TX_PANIC(listen(fd, 1024) == 0, "listen");
+	salen = sizeof(sa);
+	getsockname(fd, (struct sockaddr *)&sa, &salen);
+	tx_setblockopt(fd, 0);
+
+	for (int i = 0; i < clients; i++) {
+		pids[i] = fork();
+		if (pids[i] == 0) accept_client(&sa);
+	}
+
+	_bench.loop = tx_loop_default();
+	tx_epoll_init(_bench.loop);
+	tx_listen_init(&_bench_listen, _bench.loop, fd);
+	tx_task_init(&_bench_acceptor, _bench.loop, accept_handle, NULL);
+	tx_task_active(&_bench_acceptor, NULL);
+
+	tx_timer_init(&timer, _bench.loop, stream_stop, _bench.loop);
+	tx_timer_reset(&timer, seconds * 1000);
+
+	start = bench_nsecs(CLOCK_MONOTONIC);
+	tx_loop_main(_bench.loop);
+	start = bench_nsecs(CLOCK_MONOTONIC) - start;
+
+	for (int i = 0; i < clients; i++) {
+		kill(pids[i], SIGKILL);
+		waitpid(pids[i], NULL, 0);
+	}
+
+	fprintf(stdout, "accept batch %d clients %d: %.0f conn/s\n", _bench_batch, clients,
+			_bench_accepts / (start / 1000000000.0));
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t count;
+	size_t max_count = BENCH_MAX_COUNT;
+	unsigned window = BENCH_WINDOW;
+
+	if (argc > 1 && !strcmp(argv[1], "stream"))
+		return stream_main(argc - 2, argv + 2);
+
+	if (argc > 1 && !strcmp(argv[1], "accept"))
+		return accept_main(argc - 2, argv + 2);
+
+	if (argc > 1) max_count = strtoul(argv[1], NULL, 0);
+	if (argc > 2) window = strtoul(argv[2], NULL, 0);
+
+	_bench.loop = tx_loop_default();
+	tx_timer_ring_get(_bench.loop);
+
+	fprintf(stdout, "%-9s %9s %8s %8s %8s %8s %8s %9s %6s %6s %6s\n",
+			"dist", "count", "reset", "rearm", "stop", "drain", "expire", "rss(MB)", "p50", "p99", "max");
+
+	for (count = BENCH_MIN_COUNT; count <= max_count; count *= 10) {
+		bench_run("uniform", dist_uniform, count, window);
+		bench_run("bursty", dist_bursty, count, window);
+		bench_run("longtail", dist_longtail, count, window);
+	}
+
+	return 0;
+}
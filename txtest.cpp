@@ -0,0 +1,1904 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+
+#include "txall.h"
+
+/*
+ * behaviour tests, every case run in a forked child on a fresh default
+ * loop with the poller it name, and fail on the first broken expectation.
+ * a case the kernel can not run (no io_uring) is skipped.
+ *
+ * usage: txtest [case]
+ */
+
+#define TEST_SECONDS 10
+#define TEST_SKIPPED 77
+#define TEST_FAILED  1
+#define TEST_CHUNK   4096
+#define TEST_BUFS    8
+#define TEST_BUFSIZE 65536
+#define TEST_SNDBUF  4096
+#define TEST_SEGSIZE 100
+#define TEST_TRAIN   350
+#define TEST_PERIOD  30
+#define TEST_STALL   100
+#define TEST_WINDOW  320
+
+#define TEST_EXPECT(cond) test_expect((cond) != 0, #cond, __LINE__)
+
+struct test_case {
+	const char *name;
+	const char *poller;
+	int flags;
+	void (*call)(tx_loop_t *loop, tx_poll_t *poll);
+};
+
+/* in read what out write, the data follow test_pattern */
+struct test_pipe {
+	int fds[2];
+	tx_aiocb in;
+	tx_aiocb out;
+	tx_task_t reader;
+	tx_task_t writer;
+	tx_loop_t *loop;
+	size_t received;
+	int eof;
+};
+
+static void test_expect(int cond, const char *expr, int line)
+{
+	if (cond == 0) {
+		fprintf(stderr, "%s:%d: expect %s\n", __FILE__, line, expr);
+		exit(TEST_FAILED);
+	}
+
+	return;
+}
+
+static void test_socketpair(int fds[2])
+{
+	TX_PANIC(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair");
+	tx_setblockopt(fds[0], 0);
+	tx_setblockopt(fds[1], 0);
+	return;
+}
+
+static void test_stop(void *up)
+{
+	tx_loop_break((tx_loop_t *)up);
+	return;
+}
+
+/* whether the kernel can create an io_uring at all */
+static int test_haveuring(void)
+{
+	int fd;
+	struct io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+	fd = syscall(__NR_io_uring_setup, 4, &params);
+	if (fd == -1) return 0;
+
+	close(fd);
+	return 1;
+}
+
+/* a free loopback address of type, nothing listen on it */
+static void test_loopback(struct sockaddr_in *sin, int type)
+{
+	int fd;
+	socklen_t len = sizeof(*sin);
+
+	memset(sin, 0, sizeof(*sin));
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	fd = socket(AF_INET, type, 0);
+	TX_PANIC(fd != -1, "socket");
+	TX_PANIC(bind(fd, (struct sockaddr *)sin, sizeof(*sin)) == 0, "bind");
+	TX_PANIC(getsockname(fd, (struct sockaddr *)sin, &len) == 0, "getsockname");
+	close(fd);
+	return;
+}
+
+/* a connected tcp pair over loopback, non blocking */
+static void test_tcppair(int fds[2])
+{
+	int lfd;
+	struct sockaddr_in sin;
+
+	test_loopback(&sin, SOCK_STREAM);
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	TX_PANIC(lfd != -1, "socket");
+	TX_PANIC(bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) == 0, "bind");
+	TX_PANIC(listen(lfd, 1) == 0, "listen");
+
+	fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+	TX_PANIC(connect(fds[0], (struct sockaddr *)&sin, sizeof(sin)) == 0, "connect");
+	fds[1] = accept(lfd, NULL, NULL);
+	TX_PANIC(fds[1] != -1, "accept");
+	close(lfd);
+
+	tx_setblockopt(fds[0], 0);
+	tx_setblockopt(fds[1], 0);
+	return;
+}
+
+static unsigned char test_pattern(size_t off)
+{
+	return (unsigned char)(off % 251);
+}
+
+/* TEST_BUFS pool buffers holding the pattern from offset 0 */
+static void test_fill(tx_aiobuf bufs[], tx_loop_t *loop)
+{
+	for (int i = 0; i < TEST_BUFS; i++) {
+		TEST_EXPECT(tx_aiobuf_alloc(&bufs[i], loop, TEST_BUFSIZE) == 0);
+		for (size_t j = 0; j < TEST_BUFSIZE; j++)
+			bufs[i].iob_buf[j] = test_pattern(i * TEST_BUFSIZE + j);
+	}
+
+	return;
+}
+
+/* verify everything read against the pattern, break the loop at eof */
+static void pipe_read(void *up)
+{
+	int n;
+	unsigned char buf[TEST_CHUNK];
+	struct test_pipe *tp = (struct test_pipe *)up;
+
+	for (;;) {
+		n = recv(tp->in.tx_fd, buf, sizeof(buf), 0);
+		tx_aincb_update(&tp->in, n);
+		if (n <= 0) break;
+
+		for (int i = 0; i < n; i++)
+			TEST_EXPECT(buf[i] == test_pattern(tp->received + i));
+		tp->received += n;
+	}
+
+	if (n == -1 && errno == EAGAIN) {
+		tx_aincb_active(&tp->in, &tp->reader);
+		return;
+	}
+
+	TEST_EXPECT(n == 0);
+	tp->eof = 1;
+	tx_loop_break(tp->loop);
+	return;
+}
+
+static void pipe_attach(struct test_pipe *tp, tx_loop_t *loop, tx_poll_t *poll, void (*write)(void *))
+{
+	tp->loop = loop;
+	tp->received = 0;
+	tp->eof = 0;
+	tx_aiocb_init(&tp->out, poll, tp->fds[0]);
+	tx_aiocb_init(&tp->in, poll, tp->fds[1]);
+	tx_task_init(&tp->writer, loop, write, tp);
+	tx_task_init(&tp->reader, loop, pipe_read, tp);
+	tx_task_active(&tp->reader, NULL);
+	return;
+}
+
+/* a pipe with a small send buffer, so that the writes come out short */
+static void pipe_init(struct test_pipe *tp, tx_loop_t *loop, tx_poll_t *poll, void (*write)(void *))
+{
+	int sndbuf = TEST_SNDBUF;
+
+	test_socketpair(tp->fds);
+	setsockopt(tp->fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+	pipe_attach(tp, loop, poll, write);
+	return;
+}
+
+/*
+ * sent: the free running index wrap from INT_MAX to 0, a segment queued
+ * just before the wrap is older than the ones queued after it.
+ */
+static void test_sent(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int fds[2];
+	int index;
+	tx_aiocb out;
+	tx_aiobuf iob;
+	static char data[] = "segment";
+
+	test_socketpair(fds);
+	tx_aiocb_init(&out, poll, fds[0]);
+	TEST_EXPECT(tx_outcb_sent(&out, 0) == 0);
+
+	iob.iob_buf = data;
+	iob.iob_len = sizeof(data);
+	iob.iob_base = NULL;
+
+	index = tx_outcb_xsend(&out, &iob, 1);
+	TEST_EXPECT(index == 0);
+	TEST_EXPECT(tx_outcb_stat(&out, TX_OUTQ_DONE) == 1);
+
+	TEST_EXPECT(tx_outcb_sent(&out, 0) == 1);
+	TEST_EXPECT(tx_outcb_sent(&out, 1) == 0);
+	TEST_EXPECT(tx_outcb_sent(&out, 2) == 0);
+	TEST_EXPECT(tx_outcb_sent(&out, INT_MAX) == 1);
+	TEST_EXPECT(tx_outcb_sent(&out, INT_MAX - 1) == 1);
+	TEST_EXPECT(tx_outcb_sent(&out, (INT_MAX >> 1) + 3) == 1);
+	TEST_EXPECT(tx_outcb_sent(&out, (INT_MAX >> 1) + 2) == 0);
+
+	tx_aiocb_fini(&out);
+	close(fds[0]);
+	close(fds[1]);
+	TX_UNUSED(loop);
+	return;
+}
+
+/*
+ * outq: segments larger than the send buffer stay queued, the queue hold
+ * the only reference of their buffers and flush them as the peer read.
+ */
+static void outq_drained(void *up)
+{
+	struct test_pipe *tp = (struct test_pipe *)up;
+
+	TEST_EXPECT(tx_outcb_stat(&tp->out, TX_OUTQ_SEGMENTS) == 0);
+	TEST_EXPECT(tx_outcb_stat(&tp->out, TX_OUTQ_BYTES) == 0);
+	TEST_EXPECT(tx_outcb_stat(&tp->out, TX_OUTQ_SENT) == TEST_BUFS * TEST_BUFSIZE);
+	TEST_EXPECT(tx_outcb_stat(&tp->out, TX_OUTQ_DONE) == TEST_BUFS);
+	TEST_EXPECT(tx_outcb_sent(&tp->out, TEST_BUFS - 1) == 1);
+	TEST_EXPECT(tx_outcb_sent(&tp->out, TEST_BUFS) == 0);
+
+	shutdown(tp->fds[0], SHUT_WR);
+	return;
+}
+
+static void test_outq(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int queued;
+	struct test_pipe tp;
+	tx_aiobuf bufs[TEST_BUFS];
+	unsigned inuse = tx_mempool_getstat(loop)->mp_inuse;
+
+	pipe_init(&tp, loop, poll, outq_drained);
+	test_fill(bufs, loop);
+
+	TEST_EXPECT(tx_outcb_xsend(&tp.out, bufs, TEST_BUFS) == TEST_BUFS - 1);
+	for (int i = 0; i < TEST_BUFS; i++)
+		tx_aiobuf_drop(&bufs[i]);
+
+	/* a poller queuing its own sends may take the whole queue at once */
+	queued = tx_outcb_stat(&tp.out, TX_OUTQ_SEGMENTS);
+	TEST_EXPECT(queued > 0 || poll->tx_ops->tx_sendoutv != NULL);
+	TEST_EXPECT(queued <= TEST_BUFS);
+	TEST_EXPECT(tx_outcb_sent(&tp.out, TEST_BUFS - 1) == (queued == 0));
+	TEST_EXPECT(tx_outcb_stat(&tp.out, TX_OUTQ_DONE) == TEST_BUFS - queued);
+	TEST_EXPECT(tx_outcb_stat(&tp.out, TX_OUTQ_SENT) +
+			tx_outcb_stat(&tp.out, TX_OUTQ_BYTES) == TEST_BUFS * TEST_BUFSIZE);
+
+	tx_outcb_drained(&tp.out, &tp.writer);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(tp.received == TEST_BUFS * TEST_BUFSIZE);
+	tx_aiocb_fini(&tp.out);
+	tx_aiocb_fini(&tp.in);
+	TEST_EXPECT(tx_mempool_getstat(loop)->mp_inuse == inuse);
+	return;
+}
+
+/* xsenderr: an empty xsend is refused, a failed flush return -1 */
+static void xsenderr_drained(void *up)
+{
+	int *fired = (int *)up;
+	*fired = 1;
+	return;
+}
+
+static void test_xsenderr(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int fds[2];
+	int fired = 0;
+	tx_aiocb out;
+	tx_aiobuf iob;
+	tx_task_t drained;
+	static char data[] = "segment";
+
+	test_socketpair(fds);
+	tx_aiocb_init(&out, poll, fds[0]);
+	tx_task_init(&drained, loop, xsenderr_drained, &fired);
+
+	iob.iob_buf = data;
+	iob.iob_len = sizeof(data);
+	iob.iob_base = NULL;
+
+	errno = 0;
+	TEST_EXPECT(tx_outcb_xsend(&out, &iob, 0) == -1 && errno == EINVAL);
+	TEST_EXPECT(tx_outcb_xsend(&out, &iob, 1) == 0);
+	errno = 0;
+	TEST_EXPECT(tx_outcb_xsend(&out, &iob, 0) == -1 && errno == EINVAL);
+	TEST_EXPECT(tx_outcb_stat(&out, TX_OUTQ_DONE) == 1);
+
+	close(fds[1]);
+	errno = 0;
+	TEST_EXPECT(tx_outcb_xsend(&out, &iob, 1) == -1 && errno == EPIPE);
+	TEST_EXPECT(tx_outcb_stat(&out, TX_OUTQ_ERROR) == EPIPE);
+	TEST_EXPECT(tx_outcb_stat(&out, TX_OUTQ_SEGMENTS) == 1);
+	TEST_EXPECT(tx_outcb_sent(&out, 1) == 0);
+
+	errno = 0;
+	TEST_EXPECT(tx_outcb_xsend(&out, &iob, 1) == -1 && errno == EPIPE);
+	TEST_EXPECT(tx_outcb_stat(&out, TX_OUTQ_SEGMENTS) == 1);
+
+	tx_outcb_drained(&out, &drained);
+	tx_loop_break(loop);
+	tx_loop_main(loop);
+	TEST_EXPECT(fired == 1);
+
+	tx_aiocb_fini(&out);
+	close(fds[0]);
+	return;
+}
+
+/* writev: TEST_BUFS pool buffers through a small send buffer */
+static tx_aiobuf _writev_bufs[TEST_BUFS];
+static size_t _writev_index;
+static size_t _writev_partial;
+static size_t _writev_largest;
+
+/* advance bufs past the n byte written */
+static void writev_skip(size_t n)
+{
+	while (n > 0) {
+		tx_aiobuf *iobp = &_writev_bufs[_writev_index];
+		size_t take = min(n, iobp->iob_len);
+
+		iobp->iob_buf += take;
+		iobp->iob_len -= take;
+		n -= take;
+
+		if (iobp->iob_len == 0)
+			_writev_index++;
+	}
+
+	return;
+}
+
+/* shut the pipe down once the poller has nothing of it in flight */
+static void writev_done(struct test_pipe *tp)
+{
+	if (!tx_writable(&tp->out)) {
+		tx_outcb_prepare(&tp->out, &tp->writer, 0);
+		return;
+	}
+
+	shutdown(tp->fds[0], SHUT_WR);
+	return;
+}
+
+static void writev_write(void *up)
+{
+	int n;
+	size_t left;
+	struct test_pipe *tp = (struct test_pipe *)up;
+
+	while (_writev_index < TEST_BUFS) {
+		n = tx_outcb_writev(&tp->out, _writev_bufs + _writev_index, TEST_BUFS - _writev_index);
+		if (n == -1) {
+			TEST_EXPECT(errno == EAGAIN && !tx_writable(&tp->out));
+			tx_outcb_prepare(&tp->out, &tp->writer, 0);
+			return;
+		}
+
+		left = 0;
+		for (size_t i = _writev_index; i < TEST_BUFS; i++)
+			left += _writev_bufs[i].iob_len;
+
+		TEST_EXPECT(n > 0 && (size_t)n <= left);
+		_writev_partial += ((size_t)n < left);
+		writev_skip(n);
+	}
+
+	writev_done(tp);
+	return;
+}
+
+static void test_writev(tx_loop_t *loop, tx_poll_t *poll)
+{
+	struct test_pipe tp;
+
+	pipe_init(&tp, loop, poll, writev_write);
+	test_fill(_writev_bufs, loop);
+	tx_task_active(&tp.writer, NULL);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(_writev_index == TEST_BUFS);
+	TEST_EXPECT(_writev_partial > 0);
+	TEST_EXPECT(tp.received == TEST_BUFS * TEST_BUFSIZE);
+	return;
+}
+
+/* write: tx_outcb_write of a whole buffer at a time, no longer cut to 8K */
+static void write_write(void *up)
+{
+	int n;
+	tx_aiobuf *iobp;
+	struct test_pipe *tp = (struct test_pipe *)up;
+
+	while (_writev_index < TEST_BUFS) {
+		iobp = &_writev_bufs[_writev_index];
+		n = tx_outcb_write(&tp->out, iobp->iob_buf, iobp->iob_len);
+		if (n == -1) {
+			TEST_EXPECT(errno == EAGAIN && !tx_writable(&tp->out));
+			tx_outcb_prepare(&tp->out, &tp->writer, 0);
+			return;
+		}
+
+		TEST_EXPECT(n > 0 && (size_t)n <= iobp->iob_len);
+		_writev_largest = max(_writev_largest, (size_t)n);
+		writev_skip(n);
+	}
+
+	writev_done(tp);
+	return;
+}
+
+static void test_write(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int sndbuf = TEST_BUFSIZE;
+	struct test_pipe tp;
+
+	pipe_init(&tp, loop, poll, write_write);
+	setsockopt(tp.fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+	test_fill(_writev_bufs, loop);
+	tx_task_active(&tp.writer, NULL);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(_writev_index == TEST_BUFS);
+	TEST_EXPECT(_writev_largest > 8192);
+	TEST_EXPECT(tp.received == TEST_BUFS * TEST_BUFSIZE);
+	return;
+}
+
+/* readuntil: "hello\n" and "world\n" written as "hel", "lo\nwor", "ld\n" */
+static const char *_readuntil_pieces[] = {"hel", "lo\nwor", "ld\n", NULL};
+static const char *_readuntil_lines[] = {"hello\n", "world\n"};
+static int _readuntil_piece;
+static int _readuntil_line;
+static int _readuntil_pending;
+static int _readuntil_peer;
+static tx_loop_t *_readuntil_loop;
+static tx_task_t _readuntil_reader;
+static tx_timer_t _readuntil_timer;
+
+static void readuntil_write(void *up)
+{
+	const char *piece = _readuntil_pieces[_readuntil_piece++];
+
+	if (piece == NULL) {
+		close(_readuntil_peer);
+		return;
+	}
+
+	TEST_EXPECT(send(_readuntil_peer, piece, strlen(piece), 0) == (int)strlen(piece));
+	tx_timer_reset(&_readuntil_timer, 20);
+	TX_UNUSED(up);
+	return;
+}
+
+static void readuntil_read(void *up)
+{
+	int n;
+	tx_stream *stream = (tx_stream *)up;
+
+	for (;;) {
+		n = tx_stream_readuntil(stream, '\n', &_readuntil_reader);
+		if (n == 0) {
+			_readuntil_pending++;
+			return;
+		}
+
+		if (n == -1) break;
+		TEST_EXPECT(_readuntil_line < 2);
+		TEST_EXPECT(n == 6 && !memcmp(tx_stream_peek(stream, n), _readuntil_lines[_readuntil_line], n));
+		tx_stream_consume(stream, n);
+		_readuntil_line++;
+	}
+
+	TEST_EXPECT(stream->st_flags & TX_STREAM_EOF);
+	TEST_EXPECT(tx_stream_buffered(stream) == 0);
+	tx_loop_break(_readuntil_loop);
+	return;
+}
+
+static void test_readuntil(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int fds[2];
+	tx_aiocb in;
+	tx_stream stream;
+
+	test_socketpair(fds);
+	_readuntil_peer = fds[1];
+	_readuntil_loop = loop;
+
+	tx_aiocb_init(&in, poll, fds[0]);
+	tx_stream_init(&stream, &in, 0, 0);
+	tx_task_init(&_readuntil_reader, loop, readuntil_read, &stream);
+	tx_timer_init(&_readuntil_timer, loop, readuntil_write, NULL);
+	tx_timer_reset(&_readuntil_timer, 20);
+	tx_task_active(&_readuntil_reader, NULL);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(_readuntil_line == 2);
+	TEST_EXPECT(_readuntil_pending >= 3);
+	tx_stream_fini(&stream);
+	return;
+}
+
+/* split: a train of 100, 100, 100, 50 byte packets moved out in two calls */
+static void test_split(tx_loop_t *loop, tx_poll_t *poll)
+{
+	tx_dgram dg;
+	tx_dgram segs[4];
+	tx_membuf *mbp;
+	unsigned inuse = tx_mempool_getstat(loop)->mp_inuse;
+
+	memset(&dg, 0, sizeof(dg));
+	memset(segs, 0, sizeof(segs));
+	TEST_EXPECT(tx_aiobuf_alloc(&dg.dg_buf, loop, TEST_TRAIN) == 0);
+	for (size_t i = 0; i < TEST_TRAIN; i++)
+		dg.dg_buf.iob_buf[i] = test_pattern(i);
+
+	mbp = dg.dg_buf.iob_base;
+	dg.dg_segsize = TEST_SEGSIZE;
+	dg.dg_addrlen = sizeof(struct sockaddr_in);
+	dg.dg_addr.ss_family = AF_INET;
+
+	TEST_EXPECT(tx_dgram_split(&dg, segs, 2) == 2);
+	TEST_EXPECT(mbp->iob_use == 3);
+	TEST_EXPECT(dg.dg_buf.iob_len == TEST_TRAIN - 2 * TEST_SEGSIZE);
+
+	TEST_EXPECT(tx_dgram_split(&dg, segs + 2, 2) == 2);
+	TEST_EXPECT(mbp->iob_use == 5);
+	TEST_EXPECT(dg.dg_buf.iob_len == 0);
+	TEST_EXPECT(tx_dgram_split(&dg, segs, 4) == 0);
+
+	for (int i = 0; i < 4; i++) {
+		tx_aiobuf *iobp = &segs[i].dg_buf;
+
+		TEST_EXPECT(iobp->iob_base == mbp && segs[i].dg_segsize == 0);
+		TEST_EXPECT(iobp->iob_len == (i < 3? TEST_SEGSIZE: TEST_TRAIN - 3 * TEST_SEGSIZE));
+		TEST_EXPECT(iobp->iob_buf == (char *)mbp->iob_alloc + i * TEST_SEGSIZE);
+		TEST_EXPECT((unsigned char)iobp->iob_buf[0] == test_pattern(i * TEST_SEGSIZE));
+		TEST_EXPECT(segs[i].dg_addrlen == dg.dg_addrlen && segs[i].dg_addr.ss_family == AF_INET);
+	}
+
+	tx_dgram_drop(&dg, 1);
+	TEST_EXPECT(mbp->iob_use == 4);
+
+	/* splitting into used segs drop the slices they held */
+	TEST_EXPECT(tx_aiobuf_alloc(&dg.dg_buf, loop, TEST_TRAIN) == 0);
+	dg.dg_segsize = TEST_SEGSIZE;
+	TEST_EXPECT(tx_dgram_split(&dg, segs, 2) == 2);
+	TEST_EXPECT(mbp->iob_use == 2);
+	TEST_EXPECT(dg.dg_buf.iob_base->iob_use == 3);
+
+	tx_dgram_drop(&dg, 1);
+	tx_dgram_drop(segs, 4);
+	TEST_EXPECT(tx_mempool_getstat(loop)->mp_inuse == inuse);
+	TX_UNUSED(poll);
+	return;
+}
+
+/*
+ * pollers: io_uring created after epoll on the same loop, each aiocb keep
+ * the poller it was attached to and both carry their stream.
+ */
+static void pollers_drained(void *up)
+{
+	struct test_pipe *tp = (struct test_pipe *)up;
+
+	shutdown(tp->fds[0], SHUT_WR);
+	return;
+}
+
+static void test_pollers(tx_loop_t *loop, tx_poll_t *poll)
+{
+	tx_poll_t *uring;
+	struct test_pipe tps[2];
+	tx_aiobuf bufs[TEST_BUFS];
+
+	uring = tx_uring_init(loop, 0, 0);
+	if (uring == NULL && !test_haveuring()) exit(TEST_SKIPPED);
+	TEST_EXPECT(uring != NULL && uring != poll);
+	TEST_EXPECT(tx_epoll_init(loop) == poll);
+
+	pipe_init(&tps[0], loop, poll, pollers_drained);
+	pipe_init(&tps[1], loop, uring, pollers_drained);
+	TEST_EXPECT(tps[0].out.tx_poll == poll && tps[1].out.tx_poll == uring);
+
+	test_fill(bufs, loop);
+	for (int i = 0; i < 2; i++) {
+		TEST_EXPECT(tx_outcb_xsend(&tps[i].out, bufs, TEST_BUFS) == TEST_BUFS - 1);
+		tx_outcb_drained(&tps[i].out, &tps[i].writer);
+	}
+
+	for (int i = 0; i < TEST_BUFS; i++)
+		tx_aiobuf_drop(&bufs[i]);
+
+	while (!tps[0].eof || !tps[1].eof)
+		tx_loop_main(loop);
+
+	for (int i = 0; i < 2; i++)
+		TEST_EXPECT(tps[i].received == TEST_BUFS * TEST_BUFSIZE);
+
+	return;
+}
+
+/*
+ * fdreuse: fill the socket so the write is queued to the ring, detach and
+ * close it, the next socket get the same fd (and ring slot). a queued send
+ * still pending at the close must be gone, not sent on the new socket.
+ */
+static void test_fdreuse(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int n;
+	int fds[2];
+	int olds[2];
+	tx_aiocb old;
+	tx_aiocb out;
+	tx_timer_t timer;
+	char buf[TEST_CHUNK];
+
+	test_socketpair(olds);
+	memset(buf, 0, sizeof(buf));
+	while (send(olds[0], buf, sizeof(buf), MSG_DONTWAIT) > 0);
+
+	tx_aiocb_init(&old, poll, olds[0]);
+	TEST_EXPECT(tx_outcb_write(&old, "stale", 5) == 5);
+	TEST_EXPECT(!tx_writable(&old));
+	tx_aiocb_fini(&old);
+	close(olds[0]);
+
+	test_socketpair(fds);
+	TEST_EXPECT(fds[0] == olds[0]);
+	tx_aiocb_init(&out, poll, fds[0]);
+	TEST_EXPECT(tx_outcb_write(&out, "fresh", 5) == 5);
+
+	tx_timer_init(&timer, loop, test_stop, loop);
+	tx_timer_reset(&timer, 100);
+	tx_loop_main(loop);
+
+	n = recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT);
+	TEST_EXPECT(n == 5 && !memcmp(buf, "fresh", 5));
+	TEST_EXPECT(recv(fds[1], buf, sizeof(buf), MSG_DONTWAIT) == -1 && errno == EAGAIN);
+
+	tx_aiocb_fini(&out);
+	close(fds[0]);
+	close(fds[1]);
+	close(olds[1]);
+	return;
+}
+
+/*
+ * zdrain: zero copy sends over tcp, every buffer is held until the kernel
+ * report it done, tx_outcb_zdrained fire once all are.
+ */
+static tx_aiobuf _zdrain_bufs[TEST_BUFS];
+static int _zdrain_index;
+static tx_task_t _zdrain_task;
+
+static void zdrain_done(void *up)
+{
+	struct test_pipe *tp = (struct test_pipe *)up;
+
+	TEST_EXPECT(tx_outcb_zpending(&tp->out) == 0);
+	shutdown(tp->fds[0], SHUT_WR);
+	return;
+}
+
+static void zdrain_write(void *up)
+{
+	int n;
+	struct test_pipe *tp = (struct test_pipe *)up;
+
+	while (_zdrain_index < TEST_BUFS) {
+		tx_aiobuf *iobp = &_zdrain_bufs[_zdrain_index];
+
+		n = tx_outcb_zsend(&tp->out, iobp);
+		if (n == -1) {
+			TEST_EXPECT(errno == EAGAIN);
+			tx_outcb_prepare(&tp->out, &tp->writer, 0);
+			return;
+		}
+
+		TEST_EXPECT(n > 0 && (size_t)n <= iobp->iob_len);
+		iobp->iob_buf += n;
+		iobp->iob_len -= n;
+		_zdrain_index += (iobp->iob_len == 0);
+	}
+
+	tx_outcb_zdrained(&tp->out, &_zdrain_task);
+	return;
+}
+
+static void test_zdrain(tx_loop_t *loop, tx_poll_t *poll)
+{
+	struct test_pipe tp;
+	unsigned inuse = tx_mempool_getstat(loop)->mp_inuse;
+
+	test_tcppair(tp.fds);
+	pipe_attach(&tp, loop, poll, zdrain_write);
+	if (tx_aiocb_zerocopy(&tp.out) != 0) exit(TEST_SKIPPED);
+
+	test_fill(_zdrain_bufs, loop);
+	tx_task_init(&_zdrain_task, loop, zdrain_done, &tp);
+	tx_task_active(&tp.writer, NULL);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(tp.received == TEST_BUFS * TEST_BUFSIZE);
+	TEST_EXPECT(tx_outcb_zpending(&tp.out) == 0);
+
+	for (int i = 0; i < TEST_BUFS; i++)
+		tx_aiobuf_drop(&_zdrain_bufs[i]);
+	tx_aiocb_fini(&tp.out);
+	tx_aiocb_fini(&tp.in);
+	TEST_EXPECT(tx_mempool_getstat(loop)->mp_inuse == inuse);
+	return;
+}
+
+/*
+ * zerror: a zero copy datagram to a closed port, its completion and the
+ * ECONNREFUSED of the icmp come together. reaping the completion must
+ * leave the socket error to the next read.
+ */
+static void zerror_read(void *up)
+{
+	char buf[TEST_CHUNK];
+	tx_aiocb *filp = (tx_aiocb *)up;
+
+	errno = 0;
+	TEST_EXPECT(recv(filp->tx_fd, buf, sizeof(buf), 0) == -1 && errno == ECONNREFUSED);
+	tx_loop_break(tx_loop_get(&filp->tx_poll->tx_task));
+	return;
+}
+
+static void test_zerror(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int fd;
+	tx_aiocb filp;
+	tx_aiobuf iob;
+	tx_task_t reader;
+	struct sockaddr_in sin;
+
+	test_loopback(&sin, SOCK_DGRAM);
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	TX_PANIC(fd != -1, "socket");
+	TX_PANIC(connect(fd, (struct sockaddr *)&sin, sizeof(sin)) == 0, "connect");
+	tx_setblockopt(fd, 0);
+
+	tx_aiocb_init(&filp, poll, fd);
+	if (tx_aiocb_zerocopy(&filp) != 0) exit(TEST_SKIPPED);
+
+	TEST_EXPECT(tx_aiobuf_alloc(&iob, loop, TEST_BUFSIZE / 2) == 0);
+	tx_task_init(&reader, loop, zerror_read, &filp);
+	tx_aincb_active(&filp, &reader);
+
+	TEST_EXPECT(tx_outcb_zsend(&filp, &iob) == (int)iob.iob_len);
+	TEST_EXPECT(tx_outcb_zpending(&filp) == 1);
+	tx_aiobuf_drop(&iob);
+
+	tx_loop_main(loop);
+	TEST_EXPECT(tx_outcb_zpending(&filp) == 0);
+	tx_aiocb_fini(&filp);
+	close(fd);
+	return;
+}
+
+/*
+ * period: a 30ms periodic timer whose second fire stall the loop 100ms,
+ * three ticks are missed. TIMER_SKIP resume on the grid, TIMER_CATCHUP
+ * fire the missed ticks late. both count the overrun once.
+ */
+struct period_ctx {
+	int fires;
+	tx_loop_t *loop;
+	tx_timer_t timer;
+	tx_timer_t window;
+};
+
+static void period_fire(void *up)
+{
+	struct period_ctx *ctx = (struct period_ctx *)up;
+
+	if (++ctx->fires == 2)
+		usleep(TEST_STALL * 1000);
+
+	return;
+}
+
+static void period_stop(void *up)
+{
+	struct period_ctx *ctx = (struct period_ctx *)up;
+
+	tx_timer_stop(&ctx->timer);
+	tx_loop_break(ctx->loop);
+	return;
+}
+
+static void period_run(struct period_ctx *ctx, tx_loop_t *loop, int policy)
+{
+	ctx->fires = 0;
+	ctx->loop = loop;
+	tx_timer_init(&ctx->timer, loop, period_fire, ctx);
+	tx_timer_init(&ctx->window, loop, period_stop, ctx);
+	tx_timer_period(&ctx->timer, TEST_PERIOD, policy);
+	tx_timer_reset(&ctx->window, TEST_WINDOW);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(tx_timer_idle(&ctx->timer));
+	TEST_EXPECT(ctx->timer.tx_overrun >= 3 && ctx->timer.tx_overrun <= 4);
+	return;
+}
+
+static void test_periodskip(tx_loop_t *loop, tx_poll_t *poll)
+{
+	struct period_ctx ctx;
+
+	period_run(&ctx, loop, TIMER_SKIP);
+	TEST_EXPECT(ctx.fires >= 6 && ctx.fires <= 8);
+	TX_UNUSED(poll);
+	return;
+}
+
+static void test_periodcatchup(tx_loop_t *loop, tx_poll_t *poll)
+{
+	struct period_ctx ctx;
+
+	period_run(&ctx, loop, TIMER_CATCHUP);
+	TEST_EXPECT(ctx.fires >= 9 && ctx.fires <= 11);
+	TX_UNUSED(poll);
+	return;
+}
+
+/*
+ * callout: timers carrying their own callback fire in deadline order with
+ * their data, a stopped one never fire and one can rearm from its callback.
+ */
+struct callout_ctx {
+	int order[8];
+	int count;
+	int rearms;
+	tx_loop_t *loop;
+	tx_timer_t timers[4];
+};
+
+struct callout_arg {
+	int id;
+	struct callout_ctx *ctx;
+};
+
+static void callout_fire(void *up)
+{
+	struct callout_arg *arg = (struct callout_arg *)up;
+	struct callout_ctx *ctx = arg->ctx;
+
+	TEST_EXPECT(ctx->count < 8);
+	ctx->order[ctx->count++] = arg->id;
+
+	if (arg->id == 0 && ctx->rearms++ == 0) {
+		tx_timer_reset(&ctx->timers[0], 150);
+		return;
+	}
+
+	if (arg->id == 0)
+		tx_loop_break(ctx->loop);
+
+	return;
+}
+
+static void test_callout(tx_loop_t *loop, tx_poll_t *poll)
+{
+	struct callout_ctx ctx;
+	struct callout_arg args[4];
+	static const unsigned delays[4] = {20, 120, 70, 90};
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.loop = loop;
+
+	for (int i = 0; i < 4; i++) {
+		args[i].id = i;
+		args[i].ctx = &ctx;
+		tx_timer_init(&ctx.timers[i], loop, callout_fire, &args[i]);
+		tx_timer_reset(&ctx.timers[i], delays[i]);
+	}
+
+	tx_timer_stop(&ctx.timers[3]);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(ctx.count == 4);
+	TEST_EXPECT(ctx.order[0] == 0);
+	TEST_EXPECT(ctx.order[1] == 2);
+	TEST_EXPECT(ctx.order[2] == 1);
+	TEST_EXPECT(ctx.order[3] == 0);
+	TEST_EXPECT(tx_timer_idle(&ctx.timers[3]));
+	TX_UNUSED(poll);
+	return;
+}
+
+/*
+ * deadline: a read deadline on an idle fd fire with the timeout flag, an
+ * other one is cancelled by the data arriving first, then a write deadline
+ * on a full socket fire too.
+ */
+struct deadline_ctx {
+	int fds[2];
+	int step;
+	unsigned start;
+	tx_aiocb in;
+	tx_aiocb out;
+	tx_task_t reader;
+	tx_task_t writer;
+	tx_timer_t poke;
+	tx_loop_t *loop;
+};
+
+static void deadline_poke(void *up)
+{
+	struct deadline_ctx *ctx = (struct deadline_ctx *)up;
+
+	TEST_EXPECT(send(ctx->out.tx_fd, "x", 1, 0) == 1);
+	return;
+}
+
+static void deadline_write(void *up)
+{
+	struct deadline_ctx *ctx = (struct deadline_ctx *)up;
+
+	TEST_EXPECT(tx_outcb_timeout(&ctx->out));
+	TEST_EXPECT(ctx->writer.tx_reason == &ctx->out.tx_deadout);
+	TEST_EXPECT(tx_getticks() - ctx->start >= 40);
+	TEST_EXPECT(ctx->out.tx_filterout == NULL);
+
+	ctx->step = 3;
+	tx_loop_break(ctx->loop);
+	return;
+}
+
+static void deadline_read(void *up)
+{
+	int n;
+	char buf[TEST_CHUNK];
+	struct deadline_ctx *ctx = (struct deadline_ctx *)up;
+
+	switch (ctx->step) {
+		case 0:
+			n = recv(ctx->in.tx_fd, buf, sizeof(buf), 0);
+			tx_aincb_update(&ctx->in, n);
+			TEST_EXPECT(n == -1 && errno == EAGAIN);
+			ctx->step = 1;
+			ctx->start = tx_getticks();
+			tx_aincb_deadline(&ctx->in, &ctx->reader, 50);
+			break;
+
+		case 1:
+			TEST_EXPECT(tx_aincb_timeout(&ctx->in));
+			TEST_EXPECT(ctx->reader.tx_reason == &ctx->in.tx_deadin);
+			TEST_EXPECT(tx_getticks() - ctx->start >= 40);
+
+			ctx->step = 2;
+			ctx->start = tx_getticks();
+			tx_aincb_deadline(&ctx->in, &ctx->reader, 500);
+			TEST_EXPECT(!tx_aincb_timeout(&ctx->in));
+			tx_timer_reset(&ctx->poke, 30);
+			break;
+
+		case 2:
+			TEST_EXPECT(!tx_aincb_timeout(&ctx->in));
+			TEST_EXPECT(tx_timer_idle(&ctx->in.tx_deadin));
+			TEST_EXPECT(tx_getticks() - ctx->start < 400);
+			n = recv(ctx->in.tx_fd, buf, sizeof(buf), 0);
+			tx_aincb_update(&ctx->in, n);
+			TEST_EXPECT(n == 1);
+
+			for (;;) {
+				n = tx_outcb_write(&ctx->out, buf, sizeof(buf));
+				if (n <= 0) break;
+			}
+
+			TEST_EXPECT(n == -1 && !tx_writable(&ctx->out));
+			ctx->start = tx_getticks();
+			tx_outcb_deadline(&ctx->out, &ctx->writer, 50);
+			break;
+
+		default:
+			TEST_EXPECT(0);
+			break;
+	}
+
+	return;
+}
+
+static void test_deadline(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int sndbuf = TEST_SNDBUF;
+	struct deadline_ctx ctx;
+
+	memset(&ctx, 0, sizeof(ctx));
+	test_socketpair(ctx.fds);
+	setsockopt(ctx.fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+	ctx.loop = loop;
+	tx_aiocb_init(&ctx.out, poll, ctx.fds[0]);
+	tx_aiocb_init(&ctx.in, poll, ctx.fds[1]);
+	tx_task_init(&ctx.reader, loop, deadline_read, &ctx);
+	tx_task_init(&ctx.writer, loop, deadline_write, &ctx);
+	tx_timer_init(&ctx.poke, loop, deadline_poke, &ctx);
+	tx_task_active(&ctx.reader, NULL);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(ctx.step == 3);
+	tx_aiocb_fini(&ctx.in);
+	tx_aiocb_fini(&ctx.out);
+	close(ctx.fds[0]);
+	close(ctx.fds[1]);
+	return;
+}
+
+/*
+ * edge: the write test with the fds registered once edge triggered, every
+ * wait after a short write or an empty read cost no EPOLL_CTL_MOD.
+ */
+static void test_edge(tx_loop_t *loop, tx_poll_t *poll)
+{
+	struct test_pipe tp;
+	const tx_poll_stat *stat = tx_poll_getstat(poll);
+
+	TEST_EXPECT(tx_epoll_mode(poll, TX_EPOLL_EDGE) == TX_EPOLL_ONESHOT);
+	pipe_init(&tp, loop, poll, write_write);
+	test_fill(_writev_bufs, loop);
+	tx_task_active(&tp.writer, NULL);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(_writev_index == TEST_BUFS);
+	TEST_EXPECT(tp.received == TEST_BUFS * TEST_BUFSIZE);
+	TEST_EXPECT(stat->ps_nevents > TEST_BUFS);
+	TEST_EXPECT(stat->ps_ctl_add == 2);
+	TEST_EXPECT(stat->ps_ctl_mod == 0);
+
+	tx_aiocb_fini(&tp.out);
+	tx_aiocb_fini(&tp.in);
+	TEST_EXPECT(stat->ps_ctl_del == 2);
+	return;
+}
+
+/*
+ * changelist: attach, pollin and pollout in one pass reach the kernel as a
+ * single EPOLL_CTL_ADD, an fd attached and detached in the same pass never
+ * reach it at all.
+ */
+struct changelist_ctx {
+	int woken;
+	tx_loop_t *loop;
+	const tx_poll_stat *stat;
+};
+
+static void changelist_fail(void *up)
+{
+	TEST_EXPECT(0);
+	TX_UNUSED(up);
+	return;
+}
+
+static void changelist_write(void *up)
+{
+	struct changelist_ctx *ctx = (struct changelist_ctx *)up;
+
+	ctx->woken++;
+	TEST_EXPECT(ctx->stat->ps_ctl_add == 1);
+	TEST_EXPECT(ctx->stat->ps_ctl_mod == 0);
+	TEST_EXPECT(ctx->stat->ps_ctl_del == 0);
+	tx_loop_break(ctx->loop);
+	return;
+}
+
+static void test_changelist(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int fds[2];
+	int gone[2];
+	tx_aiocb out;
+	tx_aiocb passing;
+	tx_task_t reader, writer;
+	struct changelist_ctx ctx;
+
+	ctx.woken = 0;
+	ctx.loop = loop;
+	ctx.stat = tx_poll_getstat(poll);
+
+	test_socketpair(fds);
+	test_socketpair(gone);
+	tx_task_init(&reader, loop, changelist_fail, &ctx);
+	tx_task_init(&writer, loop, changelist_write, &ctx);
+
+	tx_aiocb_init(&out, poll, fds[0]);
+	tx_aincb_active(&out, &reader);
+	tx_outcb_prepare(&out, &writer, 0);
+
+	tx_aiocb_init(&passing, poll, gone[0]);
+	tx_aincb_active(&passing, &reader);
+	tx_aincb_stop(&passing, &reader);
+	tx_aiocb_fini(&passing);
+	close(gone[0]);
+	close(gone[1]);
+
+	TEST_EXPECT(ctx.stat->ps_ctl_add == 0);
+	tx_loop_main(loop);
+	TEST_EXPECT(ctx.woken == 1);
+
+	tx_aincb_stop(&out, &reader);
+	tx_aiocb_fini(&out);
+	TEST_EXPECT(ctx.stat->ps_ctl_del == 1);
+	close(fds[0]);
+	close(fds[1]);
+	return;
+}
+
+/*
+ * generation: an aiocb dropped without detach while its fd live on in a
+ * dup, the fd number is reused by a new aiocb. the old registration still
+ * report its event, it must be dropped as stale, not dispatched to the
+ * dead aiocb or to the new one.
+ */
+static void generation_read(void *up)
+{
+	struct changelist_ctx *ctx = (struct changelist_ctx *)up;
+
+	ctx->woken++;
+	tx_loop_break(ctx->loop);
+	return;
+}
+
+static void test_generation(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int keep;
+	int olds[2], fds[2];
+	tx_aiocb dead, live;
+	tx_timer_t timer;
+	tx_task_t stale, reader;
+	struct changelist_ctx ctx;
+	const tx_poll_stat *stat = tx_poll_getstat(poll);
+
+	ctx.woken = 0;
+	ctx.loop = loop;
+	ctx.stat = stat;
+
+	test_socketpair(olds);
+	tx_task_init(&stale, loop, changelist_fail, &ctx);
+	tx_task_init(&reader, loop, generation_read, &ctx);
+	tx_aiocb_init(&dead, poll, olds[0]);
+	tx_aincb_active(&dead, &stale);
+
+	tx_timer_init(&timer, loop, test_stop, loop);
+	tx_timer_reset(&timer, 20);
+	tx_loop_main(loop);
+	TEST_EXPECT(stat->ps_ctl_add == 1);
+
+	keep = dup(olds[0]);
+	close(olds[0]);
+	test_socketpair(fds);
+	TEST_EXPECT(fds[0] == olds[0]);
+
+	tx_aiocb_init(&live, poll, fds[0]);
+	tx_aincb_active(&live, &reader);
+	TEST_EXPECT(send(olds[1], "old", 3, 0) == 3);
+	TEST_EXPECT(send(fds[1], "new", 3, 0) == 3);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(ctx.woken == 1);
+	TEST_EXPECT(stat->ps_stale_events == 1);
+	TEST_EXPECT(stat->ps_failures == 0);
+
+	tx_aiocb_fini(&live);
+	close(fds[0]);
+	close(fds[1]);
+	close(keep);
+	close(olds[1]);
+	return;
+}
+
+/*
+ * acceptv: five pending connections taken in batches of three, every fd
+ * non-blocking and close-on-exec with its aiocb on the listener poller.
+ */
+#define ACCEPTV_CONNS 5
+#define ACCEPTV_BATCH 3
+
+struct acceptv_ctx {
+	int total;
+	int batches;
+	int newfds[ACCEPTV_CONNS];
+	tx_aiocb newcbs[ACCEPTV_CONNS];
+	tx_aiocb listener;
+	tx_task_t task;
+	tx_loop_t *loop;
+};
+
+static void acceptv_accept(void *up)
+{
+	int n;
+	int count;
+	tx_aiocb *newcbs[ACCEPTV_BATCH];
+	struct acceptv_ctx *ctx = (struct acceptv_ctx *)up;
+
+	for (;;) {
+		count = min(ACCEPTV_BATCH, ACCEPTV_CONNS - ctx->total);
+		for (int i = 0; i < count; i++)
+			newcbs[i] = &ctx->newcbs[ctx->total + i];
+
+		n = tx_listen_acceptv(&ctx->listener, ctx->newfds + ctx->total, newcbs, count);
+		if (n == -1) break;
+
+		TEST_EXPECT(n > 0 && n <= ACCEPTV_BATCH);
+		ctx->total += n;
+		ctx->batches++;
+		if (ctx->total == ACCEPTV_CONNS) {
+			tx_loop_break(ctx->loop);
+			return;
+		}
+	}
+
+	TEST_EXPECT(errno == EAGAIN);
+	tx_listen_active(&ctx->listener, &ctx->task);
+	return;
+}
+
+static void test_acceptv(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int lfd;
+	int flags;
+	int clients[ACCEPTV_CONNS];
+	struct sockaddr_in sin;
+	struct acceptv_ctx ctx;
+	const tx_poll_stat *stat = tx_poll_getstat(poll);
+
+	test_loopback(&sin, SOCK_STREAM);
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	TX_PANIC(lfd != -1, "socket");
+	TX_PANIC(bind(lfd, (struct sockaddr *)&sin, sizeof(sin)) == 0, "bind");
+	TX_PANIC(listen(lfd, ACCEPTV_CONNS) == 0, "listen");
+	tx_setblockopt(lfd, 0);
+
+	for (int i = 0; i < ACCEPTV_CONNS; i++) {
+		clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+		TX_PANIC(connect(clients[i], (struct sockaddr *)&sin, sizeof(sin)) == 0, "connect");
+	}
+
+	ctx.total = 0;
+	ctx.batches = 0;
+	ctx.loop = loop;
+	tx_listen_init(&ctx.listener, poll, lfd);
+	tx_task_init(&ctx.task, loop, acceptv_accept, &ctx);
+	tx_task_active(&ctx.task, NULL);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(ctx.total == ACCEPTV_CONNS);
+	TEST_EXPECT(ctx.batches >= 2);
+	TEST_EXPECT(stat->ps_accepts == ACCEPTV_CONNS);
+
+	for (int i = 0; i < ACCEPTV_CONNS; i++) {
+		flags = fcntl(ctx.newfds[i], F_GETFL);
+		TEST_EXPECT(flags != -1 && (flags & O_NONBLOCK));
+		if (poll->tx_ops->tx_accept == NULL)
+			TEST_EXPECT(fcntl(ctx.newfds[i], F_GETFD) & FD_CLOEXEC);
+		TEST_EXPECT(ctx.newcbs[i].tx_fd == ctx.newfds[i]);
+		TEST_EXPECT(ctx.newcbs[i].tx_poll == poll);
+		tx_aiocb_fini(&ctx.newcbs[i]);
+		close(ctx.newfds[i]);
+		close(clients[i]);
+	}
+
+	tx_listen_fini(&ctx.listener);
+	close(lfd);
+	return;
+}
+
+/*
+ * mempool: a buffer freed on one loop and taken again from the thread cache
+ * by an other loop of the thread stay charged to the pool that own it.
+ */
+static void test_mempool(tx_loop_t *loop, tx_poll_t *poll)
+{
+	tx_aiobuf iob;
+	tx_membuf *mbp, *again;
+	tx_loop_t *other = tx_loop_new();
+	const tx_mempool_stat *owner, *taker;
+
+	mbp = tx_membuf_alloc(loop, 1000);
+	TEST_EXPECT(mbp != NULL && mbp->iob_use == 1);
+	TEST_EXPECT(tx_membuf_size(mbp) >= 1000);
+
+	owner = tx_mempool_getstat(loop);
+	TEST_EXPECT(owner->mp_allocs == 1 && owner->mp_inuse == 1);
+	TEST_EXPECT(owner->mp_cachehits == 0);
+
+	tx_aiobuf_slice(&iob, mbp, 10, 100);
+	TEST_EXPECT(iob.iob_buf == (char *)mbp->iob_alloc + 10 && mbp->iob_use == 2);
+	tx_aiobuf_drop(&iob);
+	TEST_EXPECT(mbp->iob_use == 1 && owner->mp_inuse == 1);
+	tx_membuf_drop(mbp);
+	TEST_EXPECT(owner->mp_inuse == 0);
+
+	again = tx_membuf_alloc(other, 900);
+	taker = tx_mempool_getstat(other);
+	TEST_EXPECT(again == mbp);
+	TEST_EXPECT(owner->mp_allocs == 2 && owner->mp_cachehits == 1);
+	TEST_EXPECT(owner->mp_inuse == 1);
+	TEST_EXPECT(taker->mp_allocs == 0 && taker->mp_inuse == 0);
+	TEST_EXPECT(taker->mp_slabs == 0);
+	tx_membuf_drop(again);
+	TEST_EXPECT(owner->mp_inuse == 0);
+
+	mbp = tx_membuf_alloc(other, 1 << 20);
+	TEST_EXPECT(mbp != NULL && tx_membuf_size(mbp) == (1 << 20));
+	TEST_EXPECT(taker->mp_large == 1 && taker->mp_inuse == 1);
+	tx_membuf_drop(mbp);
+	TEST_EXPECT(taker->mp_inuse == 0);
+
+	tx_mempool_free(other);
+	tx_loop_delete(other);
+	TX_UNUSED(poll);
+	return;
+}
+
+/*
+ * relay: a client write TEST_BUFS * TEST_BUFSIZE pattern byte and half
+ * close, the relay move them to the other pair and propagate the eof, the
+ * far end still can answer through the half closed socket. spliced on
+ * epoll, copied on io_uring which queue its own sends.
+ */
+struct relay_ctx {
+	int client[2];
+	size_t written;
+	int done;
+	tx_aiocb out;
+	tx_aiocb src;
+	tx_task_t writer;
+	tx_task_t finish;
+	tx_relay relay;
+	struct test_pipe *tp;
+};
+
+static void relay_write(void *up)
+{
+	int n;
+	char buf[TEST_CHUNK];
+	struct relay_ctx *ctx = (struct relay_ctx *)up;
+
+	while (ctx->written < TEST_BUFS * TEST_BUFSIZE) {
+		for (int i = 0; i < TEST_CHUNK; i++)
+			buf[i] = test_pattern(ctx->written + i);
+
+		n = tx_outcb_write(&ctx->out, buf, TEST_CHUNK);
+		if (n == -1) {
+			TEST_EXPECT(errno == EAGAIN);
+			tx_outcb_prepare(&ctx->out, &ctx->writer, 0);
+			return;
+		}
+
+		ctx->written += n;
+	}
+
+	if (!tx_writable(&ctx->out)) {
+		tx_outcb_prepare(&ctx->out, &ctx->writer, 0);
+		return;
+	}
+
+	shutdown(ctx->client[0], SHUT_WR);
+	return;
+}
+
+static void relay_done(void *up)
+{
+	struct relay_ctx *ctx = (struct relay_ctx *)up;
+
+	ctx->done++;
+	TEST_EXPECT(ctx->finish.tx_reason == &ctx->relay);
+	if (ctx->tp->eof) tx_loop_break(ctx->tp->loop);
+	return;
+}
+
+static void test_relay(tx_loop_t *loop, tx_poll_t *poll)
+{
+	char ch;
+	struct test_pipe tp;
+	struct relay_ctx ctx;
+
+	memset(&ctx, 0, sizeof(ctx));
+	test_socketpair(ctx.client);
+	tx_aiocb_init(&ctx.out, poll, ctx.client[0]);
+	tx_aiocb_init(&ctx.src, poll, ctx.client[1]);
+	tx_task_init(&ctx.writer, loop, relay_write, &ctx);
+	tx_task_init(&ctx.finish, loop, relay_done, &ctx);
+
+	ctx.tp = &tp;
+	pipe_init(&tp, loop, poll, NULL);
+	tx_relay_init(&ctx.relay, &ctx.src, &tp.out);
+	TEST_EXPECT(!(ctx.relay.rl_flags & TX_RELAY_SPLICE) == (poll->tx_ops->tx_sendout != NULL));
+
+	tx_relay_start(&ctx.relay, &ctx.finish);
+	tx_task_active(&ctx.writer, NULL);
+	tx_loop_main(loop);
+
+	/* the eof may reach the reader before the done task ran */
+	if (ctx.done == 0) tx_loop_main(loop);
+
+	TEST_EXPECT(tp.eof);
+	TEST_EXPECT(tp.received == TEST_BUFS * TEST_BUFSIZE);
+	TEST_EXPECT(ctx.done == 1);
+	TEST_EXPECT((ctx.relay.rl_flags & (TX_RELAY_EOF| TX_RELAY_DONE)) == (TX_RELAY_EOF| TX_RELAY_DONE));
+	TEST_EXPECT(ctx.relay.rl_error == 0);
+	TEST_EXPECT(ctx.relay.rl_total == TEST_BUFS * TEST_BUFSIZE);
+
+	/* only the write side of the relay destination is closed */
+	TEST_EXPECT(send(tp.fds[1], "r", 1, 0) == 1);
+	TEST_EXPECT(recv(tp.fds[0], &ch, 1, 0) == 1 && ch == 'r');
+
+	tx_relay_fini(&ctx.relay);
+	tx_aiocb_fini(&ctx.out);
+	tx_aiocb_fini(&ctx.src);
+	tx_aiocb_fini(&tp.out);
+	tx_aiocb_fini(&tp.in);
+	close(ctx.client[0]);
+	close(ctx.client[1]);
+	close(tp.fds[0]);
+	close(tp.fds[1]);
+	return;
+}
+
+/*
+ * sendfile: TEST_BUFS * TEST_BUFSIZE byte of a file through a small send
+ * buffer, resumed from the offset after every EAGAIN. sendpipe: the same
+ * from a pipe grown to hold it all, which sendfile and pread refuse.
+ */
+struct sendfile_ctx {
+	int fd;
+	int waits;
+	off_t offset;
+	size_t total;
+	struct test_pipe tp;
+};
+
+static void sendfile_write(void *up)
+{
+	int n;
+	off_t before;
+	struct sendfile_ctx *ctx = (struct sendfile_ctx *)up;
+
+	while ((size_t)ctx->offset < ctx->total) {
+		before = ctx->offset;
+		n = tx_outcb_sendfile(&ctx->tp.out, ctx->fd, &ctx->offset, ctx->total - ctx->offset);
+		if (n == -1) {
+			TEST_EXPECT(errno == EAGAIN && !tx_writable(&ctx->tp.out));
+			TEST_EXPECT(ctx->offset == before);
+			ctx->waits++;
+			tx_outcb_prepare(&ctx->tp.out, &ctx->tp.writer, 0);
+			return;
+		}
+
+		TEST_EXPECT(n > 0 && ctx->offset == before + n);
+	}
+
+	writev_done(&ctx->tp);
+	return;
+}
+
+static void sendfile_run(struct sendfile_ctx *ctx, tx_loop_t *loop, tx_poll_t *poll, size_t total)
+{
+	ctx->waits = 0;
+	ctx->offset = 0;
+	ctx->total = total;
+	pipe_init(&ctx->tp, loop, poll, sendfile_write);
+	ctx->tp.writer.tx_data = ctx;
+	tx_task_active(&ctx->tp.writer, NULL);
+	tx_loop_main(loop);
+
+	TEST_EXPECT(ctx->tp.eof);
+	TEST_EXPECT(ctx->tp.received == total);
+	TEST_EXPECT((size_t)ctx->offset == total);
+	TEST_EXPECT(ctx->waits > 0);
+	return;
+}
+
+static void sendfile_fill(int fd, size_t total)
+{
+	unsigned char buf[TEST_CHUNK];
+
+	for (size_t off = 0; off < total; off += TEST_CHUNK) {
+		for (int i = 0; i < TEST_CHUNK; i++)
+			buf[i] = test_pattern(off + i);
+		TX_PANIC(write(fd, buf, TEST_CHUNK) == TEST_CHUNK, "write");
+	}
+
+	return;
+}
+
+static void test_sendfile(tx_loop_t *loop, tx_poll_t *poll)
+{
+	char path[] = "/tmp/txtest.XXXXXX";
+	struct sendfile_ctx ctx;
+
+	ctx.fd = mkstemp(path);
+	TX_PANIC(ctx.fd != -1, "mkstemp");
+	unlink(path);
+	sendfile_fill(ctx.fd, TEST_BUFS * TEST_BUFSIZE);
+
+	sendfile_run(&ctx, loop, poll, TEST_BUFS * TEST_BUFSIZE);
+	tx_aiocb_fini(&ctx.tp.out);
+	tx_aiocb_fini(&ctx.tp.in);
+	close(ctx.tp.fds[0]);
+	close(ctx.tp.fds[1]);
+	close(ctx.fd);
+	return;
+}
+
+static void test_sendpipe(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int pfd[2];
+	off_t offset = 0;
+	struct sendfile_ctx ctx;
+
+	TX_PANIC(pipe(pfd) == 0, "pipe");
+	if (fcntl(pfd[1], F_SETPIPE_SZ, TEST_BUFS * TEST_BUFSIZE) == -1)
+		exit(TEST_SKIPPED);
+
+	sendfile_fill(pfd[1], TEST_BUFS * TEST_BUFSIZE);
+	close(pfd[1]);
+
+	ctx.fd = pfd[0];
+	sendfile_run(&ctx, loop, poll, TEST_BUFS * TEST_BUFSIZE);
+
+	/* the pipe is empty now */
+	TEST_EXPECT(tx_writable(&ctx.tp.out));
+	TEST_EXPECT(tx_outcb_sendfile(&ctx.tp.out, pfd[0], &offset, TEST_CHUNK) == 0);
+	TEST_EXPECT(offset == 0);
+
+	tx_aiocb_fini(&ctx.tp.out);
+	tx_aiocb_fini(&ctx.tp.in);
+	close(ctx.tp.fds[0]);
+	close(ctx.tp.fds[1]);
+	close(pfd[0]);
+	return;
+}
+
+/*
+ * dgram: eight datagrams and a train of TEST_TRAIN byte (four packets, no
+ * GSO) go out in one tx_dgram_send, and come in with one tx_dgram_recv,
+ * whose short batch already clear tx_readable. a second round reuse the
+ * receive buffers nobody else hold.
+ */
+#define DGRAM_COUNT 8
+#define DGRAM_RECVS 16
+
+struct dgram_ctx {
+	int rounds;
+	int received;
+	tx_aiocb in;
+	tx_task_t reader;
+	tx_loop_t *loop;
+	tx_membuf *bases[DGRAM_RECVS];
+	tx_dgram dgs[DGRAM_RECVS];
+	struct sockaddr_in from;
+};
+
+static void dgram_fill(tx_dgram *dgp, size_t len, size_t start, tx_loop_t *loop)
+{
+	memset(dgp, 0, sizeof(*dgp));
+	TEST_EXPECT(tx_aiobuf_alloc(&dgp->dg_buf, loop, len) == 0);
+	for (size_t i = 0; i < len; i++)
+		dgp->dg_buf.iob_buf[i] = test_pattern(start + i);
+	return;
+}
+
+static void dgram_read(void *up)
+{
+	int n;
+	tx_dgram *dgp;
+	struct sockaddr_in *sin;
+	struct dgram_ctx *ctx = (struct dgram_ctx *)up;
+
+	n = tx_dgram_recv(&ctx->in, ctx->dgs, DGRAM_RECVS, 2048);
+	if (n == -1) {
+		TEST_EXPECT(errno == EAGAIN && !tx_readable(&ctx->in));
+		tx_aincb_active(&ctx->in, &ctx->reader);
+		return;
+	}
+
+	ctx->rounds++;
+	ctx->received = n;
+	TEST_EXPECT(!tx_readable(&ctx->in));
+
+	for (int i = 0; i < n; i++) {
+		dgp = &ctx->dgs[i];
+		sin = (struct sockaddr_in *)&dgp->dg_addr;
+		TEST_EXPECT(dgp->dg_addrlen == sizeof(*sin) && dgp->dg_segsize == 0);
+		TEST_EXPECT(sin->sin_port == ctx->from.sin_port);
+
+		if (i < DGRAM_COUNT) {
+			TEST_EXPECT(dgp->dg_buf.iob_len == 100 + 50 * (size_t)i);
+			TEST_EXPECT((unsigned char)dgp->dg_buf.iob_buf[0] == test_pattern(1000 * i));
+		} else {
+			size_t off = (i - DGRAM_COUNT) * TEST_SEGSIZE;
+			TEST_EXPECT(dgp->dg_buf.iob_len == min(TEST_SEGSIZE, TEST_TRAIN - off));
+			TEST_EXPECT((unsigned char)dgp->dg_buf.iob_buf[0] == test_pattern(off));
+		}
+	}
+
+	tx_loop_break(ctx->loop);
+	return;
+}
+
+static void test_dgram(tx_loop_t *loop, tx_poll_t *poll)
+{
+	int fds[2];
+	tx_aiocb out;
+	tx_dgram dgs[DGRAM_COUNT + 1];
+	struct sockaddr_in sin;
+	struct dgram_ctx ctx;
+	socklen_t len = sizeof(ctx.from);
+	unsigned inuse = tx_mempool_getstat(loop)->mp_inuse;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.loop = loop;
+	test_loopback(&sin, SOCK_DGRAM);
+	fds[0] = socket(AF_INET, SOCK_DGRAM, 0);
+	fds[1] = socket(AF_INET, SOCK_DGRAM, 0);
+	TX_PANIC(fds[0] != -1 && fds[1] != -1, "socket");
+	TX_PANIC(bind(fds[1], (struct sockaddr *)&sin, sizeof(sin)) == 0, "bind");
+	TX_PANIC(connect(fds[0], (struct sockaddr *)&sin, sizeof(sin)) == 0, "connect");
+	TX_PANIC(getsockname(fds[0], (struct sockaddr *)&ctx.from, &len) == 0, "getsockname");
+	tx_setblockopt(fds[0], 0);
+	tx_setblockopt(fds[1], 0);
+
+	tx_aiocb_init(&out, poll, fds[0]);
+	tx_aiocb_init(&ctx.in, poll, fds[1]);
+	tx_task_init(&ctx.reader, loop, dgram_read, &ctx);
+
+	for (int i = 0; i < DGRAM_COUNT; i++)
+		dgram_fill(&dgs[i], 100 + 50 * i, 1000 * i, loop);
+	dgram_fill(&dgs[DGRAM_COUNT], TEST_TRAIN, 0, loop);
+	dgs[DGRAM_COUNT].dg_segsize = TEST_SEGSIZE;
+
+	TEST_EXPECT(tx_dgram_send(&out, dgs, DGRAM_COUNT + 1) == DGRAM_COUNT + 1);
+	tx_task_active(&ctx.reader, NULL);
+	tx_loop_main(loop);
+	TEST_EXPECT(ctx.rounds == 1);
+	TEST_EXPECT(ctx.received == DGRAM_COUNT + 4);
+
+	for (int i = 0; i < DGRAM_RECVS; i++)
+		ctx.bases[i] = ctx.dgs[i].dg_buf.iob_base;
+
+	/* again, into the buffers of the first round */
+	tx_dgram_drop(dgs, DGRAM_COUNT + 1);
+	for (int i = 0; i < DGRAM_COUNT; i++)
+		dgram_fill(&dgs[i], 100 + 50 * i, 1000 * i, loop);
+	dgram_fill(&dgs[DGRAM_COUNT], TEST_TRAIN, 0, loop);
+	dgs[DGRAM_COUNT].dg_segsize = TEST_SEGSIZE;
+
+	TEST_EXPECT(tx_dgram_send(&out, dgs, DGRAM_COUNT + 1) == DGRAM_COUNT + 1);
+	tx_task_active(&ctx.reader, NULL);
+	tx_loop_main(loop);
+	TEST_EXPECT(ctx.rounds == 2);
+	TEST_EXPECT(ctx.received == DGRAM_COUNT + 4);
+
+	for (int i = 0; i < DGRAM_RECVS; i++)
+		TEST_EXPECT(ctx.dgs[i].dg_buf.iob_base == ctx.bases[i]);
+
+	tx_dgram_drop(dgs, DGRAM_COUNT + 1);
+	tx_dgram_drop(ctx.dgs, DGRAM_RECVS);
+	TEST_EXPECT(tx_mempool_getstat(loop)->mp_inuse == inuse);
+
+	tx_aiocb_fini(&out);
+	tx_aiocb_fini(&ctx.in);
+	close(fds[0]);
+	close(fds[1]);
+	return;
+}
+
+/*
+ * autocork: over a SOCK_SEQPACKET pair every write leave as its own record,
+ * the ten small writes of one pass must arrive as a single record, flushed
+ * at the end of the pass. disabling flush what is corked at once.
+ */
+#define AUTOCORK_WRITES 10
+
+struct autocork_ctx {
+	int fds[2];
+	int step;
+	char expect[256];
+	size_t expected;
+	tx_aiocb out;
+	tx_task_t writer;
+	tx_loop_t *loop;
+};
+
+static void autocork_put(struct autocork_ctx *ctx, int count)
+{
+	int len;
+	char piece[32];
+
+	ctx->expected = 0;
+	for (int i = 0; i < count; i++) {
+		len = snprintf(piece, sizeof(piece), "piece %d\n", i);
+		TEST_EXPECT(tx_outcb_write(&ctx->out, piece, len) == len);
+		memcpy(ctx->expect + ctx->expected, piece, len);
+		ctx->expected += len;
+	}
+
+	return;
+}
+
+static void autocork_record(struct autocork_ctx *ctx)
+{
+	char buf[512];
+	ssize_t n;
+
+	n = recv(ctx->fds[1], buf, sizeof(buf), 0);
+	TEST_EXPECT(n == (ssize_t)ctx->expected);
+	TEST_EXPECT(memcmp(buf, ctx->expect, n) == 0);
+	TEST_EXPECT(recv(ctx->fds[1], buf, sizeof(buf), 0) == -1 && errno == EAGAIN);
+	return;
+}
+
+static void autocork_write(void *up)
+{
+	char ch;
+	struct autocork_ctx *ctx = (struct autocork_ctx *)up;
+
+	if (ctx->step++ == 0) {
+		autocork_put(ctx, AUTOCORK_WRITES);
+		TEST_EXPECT(tx_outcb_stat(&ctx->out, TX_OUTQ_SEGMENTS) == 1);
+		TEST_EXPECT(recv(ctx->fds[1], &ch, 1, MSG_PEEK) == -1 && errno == EAGAIN);
+
+		/* wait for the corked output to drain */
+		tx_outcb_prepare(&ctx->out, &ctx->writer, 0);
+		return;
+	}
+
+	TEST_EXPECT(tx_outcb_stat(&ctx->out, TX_OUTQ_SEGMENTS) == 0);
+	TEST_EXPECT(tx_outcb_stat(&ctx->out, TX_OUTQ_SENT) == (int)ctx->expected);
+	autocork_record(ctx);
+
+	autocork_put(ctx, 3);
+	TEST_EXPECT(recv(ctx->fds[1], &ch, 1, MSG_PEEK) == -1 && errno == EAGAIN);
+	TEST_EXPECT(tx_aiocb_autocork(&ctx->out, 0) == 0);
+	tx_loop_break(ctx->loop);
+	return;
+}
+
+static void test_autocork(tx_loop_t *loop, tx_poll_t *poll)
+{
+	tx_timer_t timer;
+	struct autocork_ctx ctx;
+
+	memset(&ctx, 0, sizeof(ctx));
+	TX_PANIC(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, ctx.fds) == 0, "socketpair");
+	tx_setblockopt(ctx.fds[0], 0);
+	tx_setblockopt(ctx.fds[1], 0);
+
+	ctx.loop = loop;
+	tx_aiocb_init(&ctx.out, poll, ctx.fds[0]);
+	tx_task_init(&ctx.writer, loop, autocork_write, &ctx);
+	TEST_EXPECT(tx_aiocb_autocork(&ctx.out, 1) == 0);
+	tx_task_active(&ctx.writer, NULL);
+	tx_loop_main(loop);
+
+	/* a poller queuing its own sends may still hold the last record */
+	if (!tx_writable(&ctx.out)) {
+		tx_timer_init(&timer, loop, test_stop, loop);
+		tx_timer_reset(&timer, 50);
+		tx_loop_main(loop);
+	}
+
+	TEST_EXPECT(ctx.step == 2);
+	autocork_record(&ctx);
+
+	tx_aiocb_fini(&ctx.out);
+	close(ctx.fds[0]);
+	close(ctx.fds[1]);
+	return;
+}
+
+static struct test_case _test_cases[] = {
+	{"sent", "epoll", 0, test_sent},
+	{"outq", "epoll", 0, test_outq},
+	{"outq", "uring", 0, test_outq},
+	{"outq", "uring", TX_URING_FIXEDFILE| TX_URING_FIXEDBUF, test_outq},
+	{"xsenderr", "epoll", 0, test_xsenderr},
+	{"writev", "epoll", 0, test_writev},
+	{"writev", "uring", 0, test_writev},
+	{"write", "epoll", 0, test_write},
+	{"write", "uring", 0, test_write},
+	{"readuntil", "epoll", 0, test_readuntil},
+	{"readuntil", "uring", 0, test_readuntil},
+	{"readuntil", "uring", TX_URING_FIXEDFILE| TX_URING_FIXEDBUF, test_readuntil},
+	{"split", "epoll", 0, test_split},
+	{"pollers", "epoll", 0, test_pollers},
+	{"fdreuse", "uring", 0, test_fdreuse},
+	{"fdreuse", "uring", TX_URING_FIXEDFILE, test_fdreuse},
+	{"zdrain", "epoll", 0, test_zdrain},
+	{"zerror", "epoll", 0, test_zerror},
+	{"period", "epoll", 0, test_periodskip},
+	{"period", "epoll", 0, test_periodcatchup},
+	{"callout", "epoll", 0, test_callout},
+	{"deadline", "epoll", 0, test_deadline},
+	{"deadline", "uring", 0, test_deadline},
+	{"edge", "epoll", 0, test_edge},
+	{"changelist", "epoll", 0, test_changelist},
+	{"generation", "epoll", 0, test_generation},
+	{"acceptv", "epoll", 0, test_acceptv},
+	{"acceptv", "uring", 0, test_acceptv},
+	{"mempool", "epoll", 0, test_mempool},
+	{"relay", "epoll", 0, test_relay},
+	{"relay", "uring", 0, test_relay},
+	{"sendfile", "epoll", 0, test_sendfile},
+	{"sendfile", "uring", 0, test_sendfile},
+	{"sendpipe", "epoll", 0, test_sendpipe},
+	{"sendpipe", "uring", 0, test_sendpipe},
+	{"dgram", "epoll", 0, test_dgram},
+	{"dgram", "uring", 0, test_dgram},
+	{"autocork", "epoll", 0, test_autocork},
+	{"autocork", "uring", 0, test_autocork},
+	{NULL, NULL, 0, NULL}
+};
+
+static void test_child(struct test_case *tcp)
+{
+	tx_poll_t *poll;
+	tx_loop_t *loop = tx_loop_default();
+
+	alarm(TEST_SECONDS);
+	poll = strcmp(tcp->poller, "uring")? tx_epoll_init(loop): tx_uring_init(loop, tcp->flags, 0);
+	if (poll == NULL) exit(TEST_SKIPPED);
+
+	tcp->call(loop, poll);
+	exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	pid_t pid;
+	int status;
+	int failed = 0;
+	struct test_case *tcp;
+
+	signal(SIGPIPE, SIG_IGN);
+	for (tcp = _test_cases; tcp->name != NULL; tcp++) {
+		if (argc > 1 && strcmp(argv[1], tcp->name))
+			continue;
+
+		fflush(stdout);
+		pid = fork();
+		TX_PANIC(pid != -1, "fork test failure");
+		if (pid == 0) test_child(tcp);
+
+		TX_PANIC(waitpid(pid, &status, 0) == pid, "wait test failure");
+		if (WIFEXITED(status) && WEXITSTATUS(status) == TEST_SKIPPED) {
+			fprintf(stdout, "skip %s %s flags %#x\n", tcp->name, tcp->poller, tcp->flags);
+		} else if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			fprintf(stdout, "ok   %s %s flags %#x\n", tcp->name, tcp->poller, tcp->flags);
+		} else {
+			fprintf(stdout, "FAIL %s %s flags %#x\n", tcp->name, tcp->poller, tcp->flags);
+			failed++;
+		}
+	}
+
+	return failed != 0;
+}